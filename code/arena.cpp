@@ -0,0 +1,74 @@
+// $Id: arena.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <iomanip>
+
+using namespace std;
+
+#include "arena.h"
+#include "debug.h"
+
+atomic<size_t> slab_pool::unpooled {0};
+
+// slab_pool::pools -
+//    One pool per GRANULE-sized class, created on first use.  Held
+//    in a function static so it outlives every pooled object.
+
+vector<unique_ptr<slab_pool>>& slab_pool::pools() {
+   static vector<unique_ptr<slab_pool>> table
+          (MAX_POOLED / GRANULE + 1);
+   return table;
+}
+
+slab_pool* slab_pool::for_size (size_t size) {
+   if (size > MAX_POOLED) return nullptr;
+   size_t index = (size + GRANULE - 1) / GRANULE;
+   unique_ptr<slab_pool>& pool = pools()[index];
+   if (pool == nullptr) {
+      pool = make_unique<slab_pool> (index * GRANULE);
+   }
+   return pool.get();
+}
+
+void slab_pool::new_chunk() {
+   chunks.push_back (make_unique<char[]> (CHUNK_BYTES));
+   bump = chunks.back().get();
+   bump_end = bump + CHUNK_BYTES / block_size * block_size;
+   DEBUGF ('a', "size " << block_size << ": chunk " << chunks.size());
+}
+
+void* slab_pool::allocate() {
+   lock_guard<mutex> guard (lock);
+   ++allocated;
+   if (free_list != nullptr) {
+      free_block* block = free_list;
+      free_list = block->next;
+      return block;
+   }
+   if (bump == bump_end) new_chunk();
+   void* block = bump;
+   bump += block_size;
+   return block;
+}
+
+void slab_pool::deallocate (void* block) {
+   lock_guard<mutex> guard (lock);
+   ++released;
+   free_block* freed = static_cast<free_block*> (block);
+   freed->next = free_list;
+   free_list = freed;
+}
+
+void slab_pool::report (ostream& out) {
+   out << "    size   objects      live    chunks\n";
+   for (const auto& pool: pools()) {
+      if (pool == nullptr) continue;
+      lock_guard<mutex> guard (pool->lock);
+      out << setw (8) << pool->block_size
+          << setw (10) << pool->allocated
+          << setw (10) << pool->allocated - pool->released
+          << setw (10) << pool->chunks.size() << '\n';
+   }
+   out << "unpooled heap allocations: " << unpooled.load() << '\n';
+}
+
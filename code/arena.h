@@ -0,0 +1,153 @@
+// $Id: arena.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// arena -
+//    Slab allocation for the objects that make up the tree.  Objects
+//    are carved out of large chunks, one pool per size class, and
+//    freed objects go onto a free list for reuse instead of back to
+//    the heap.  Chunks are only returned when the program exits.
+//    Each pool has its own lock, since the reclaimer thread frees
+//    objects while the shell allocates them.
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// slab_pool -
+//    Fixed-size blocks for one size class.
+// for_size -
+//    The pool serving objects of the given size, or nullptr if the
+//    size is too big to pool.
+// report -
+//    Prints the counters of every pool that has been used.
+
+class slab_pool {
+   private:
+      static constexpr size_t GRANULE {16};
+      static constexpr size_t MAX_POOLED {512};
+      static constexpr size_t CHUNK_BYTES {64 * 1024};
+      struct free_block { free_block* next; };
+      size_t block_size;
+      mutex lock;
+      vector<unique_ptr<char[]>> chunks;
+      free_block* free_list {nullptr};
+      char* bump {nullptr};
+      char* bump_end {nullptr};
+      size_t allocated {0};
+      size_t released {0};
+      void new_chunk();
+      static vector<unique_ptr<slab_pool>>& pools();
+   public:
+      explicit slab_pool (size_t size): block_size (size) {}
+      slab_pool (const slab_pool&) = delete;
+      slab_pool& operator= (const slab_pool&) = delete;
+      void* allocate();
+      void deallocate (void* block);
+      static slab_pool* for_size (size_t size);
+      static void report (ostream& out);
+      static atomic<size_t> unpooled;
+};
+
+// arena_allocator -
+//    Standard allocator which takes single objects from slab_pool
+//    and anything else from the heap.  Stateless, so all instances
+//    compare equal.
+
+template <typename item_t>
+class arena_allocator {
+   public:
+      using value_type = item_t;
+      arena_allocator() = default;
+      template <typename other_t>
+      arena_allocator (const arena_allocator<other_t>&) {}
+      item_t* allocate (size_t count) {
+         slab_pool* pool = count == 1
+                         ? slab_pool::for_size (sizeof (item_t))
+                         : nullptr;
+         if (pool == nullptr or alignof (item_t) > 16) {
+            ++slab_pool::unpooled;
+            return static_cast<item_t*> (
+                   ::operator new (count * sizeof (item_t)));
+         }
+         return static_cast<item_t*> (pool->allocate());
+      }
+      void deallocate (item_t* item, size_t count) {
+         slab_pool* pool = count == 1
+                         ? slab_pool::for_size (sizeof (item_t))
+                         : nullptr;
+         if (pool == nullptr or alignof (item_t) > 16) {
+            ::operator delete (item);
+         }else {
+            pool->deallocate (item);
+         }
+      }
+      template <typename other_t>
+      bool operator== (const arena_allocator<other_t>&) const {
+         return true;
+      }
+      template <typename other_t>
+      bool operator!= (const arena_allocator<other_t>&) const {
+         return false;
+      }
+};
+
+// make_pooled -
+//    Drop-in for make_shared.  The object and its control block
+//    share one slab block.  Build with -DYSH_NO_ARENA to go back to
+//    make_shared, which counts every object as an unpooled heap
+//    allocation so the two can be compared.
+
+template <typename item_t, typename... args_t>
+shared_ptr<item_t> make_pooled (args_t&&... args) {
+#ifdef YSH_NO_ARENA
+   ++slab_pool::unpooled;
+   return make_shared<item_t> (forward<args_t> (args)...);
+#else
+   return allocate_shared<item_t> (arena_allocator<item_t>(),
+                                   forward<args_t> (args)...);
+#endif
+}
+
+// pooled_new, pooled_delete -
+//    The same for objects that manage their own lifetime, such as
+//    inodes with the count inside them.  pooled_delete must get an
+//    object made by pooled_new with the same item_t.
+
+template <typename item_t, typename... args_t>
+item_t* pooled_new (args_t&&... args) {
+#ifdef YSH_NO_ARENA
+   ++slab_pool::unpooled;
+   return new item_t (forward<args_t> (args)...);
+#else
+   arena_allocator<item_t> alloc;
+   item_t* item = alloc.allocate (1);
+   try {
+      return new (item) item_t (forward<args_t> (args)...);
+   }catch (...) {
+      alloc.deallocate (item, 1);
+      throw;
+   }
+#endif
+}
+
+template <typename item_t>
+void pooled_delete (item_t* item) {
+#ifdef YSH_NO_ARENA
+   delete item;
+#else
+   item->~item_t();
+   arena_allocator<item_t>().deallocate (item, 1);
+#endif
+}
+
+#endif
+
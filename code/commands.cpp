@@ -1,34 +1,158 @@
 // $Id: commands.cpp,v 1.20 2021-01-11 15:52:17-08 - - $
 // Evan Clark, Brady Chan
 
+#include <iomanip>
+
+#include "arena.h"
 #include "commands.h"
 #include "debug.h"
 
-command_hash cmd_hash {
+// command_table -
+//    Every builtin, by name.  To add a command, declare its fn_ in
+//    commands.h and add a row here; command_index is rebuilt from
+//    this table at compile time.
+
+struct command_entry {
+   string_view name;
+   command_fn fn;
+};
+
+constexpr command_entry command_table[] {
+   {"allocstats", fn_allocstats},
+   {"cachestats", fn_cachestats},
    {"cat"   , fn_cat   },
    {"cd"    , fn_cd    },
+   {"checkpoint", fn_checkpoint},
    {"echo"  , fn_echo  },
    {"exit"  , fn_exit  },
+   {"journalstats", fn_journalstats},
+   {"load"  , fn_load  },
    {"ls"    , fn_ls    },
    {"lsr"   , fn_lsr   },
    {"make"  , fn_make  },
+   {"memstats", fn_memstats},
    {"mkdir" , fn_mkdir },
+   {"mount" , fn_mount },
    {"prompt", fn_prompt},
    {"pwd"   , fn_pwd   },
    {"rm"    , fn_rm    },
    {"rmr"   , fn_rmr   },
+   {"rollback", fn_rollback},
+   {"save"  , fn_save  },
+   {"stats" , fn_stats },
+   {"sync"  , fn_sync  },
 };
 
-command_fn find_command_fn (const string& cmd) {
-   // Note: value_type is pair<const key_type, mapped_type>
-   // So: iterator->first is key_type (string)
-   // So: iterator->second is mapped_type (command_fn)
-   DEBUGF ('c', "[" << cmd << "]");
-   const auto result = cmd_hash.find (cmd);
-   if (result == cmd_hash.end()) {
-      throw command_error (cmd + ": no such function");
+constexpr size_t COMMAND_COUNT = size (command_table);
+
+// command_index -
+//    Perfect hash over command_table.  The constructor tries seeds
+//    for a seeded FNV-1a hash until every name lands in its own
+//    slot, so a lookup is one hash, one slot load and one compare.
+//    It runs at compile time; if no seed works the build fails.
+
+class command_index {
+   public:
+      static constexpr size_t SLOTS = 64;
+      static constexpr uint8_t EMPTY = 0xFF;
+      static_assert (COMMAND_COUNT < EMPTY);
+      static_assert (COMMAND_COUNT * 2 <= SLOTS);
+      constexpr command_index() {
+         for (uint32_t tries = 0; tries < 100000; ++tries) {
+            if (try_seed (tries)) return;
+         }
+         throw logic_error ("command_index: no perfect seed");
+      }
+      constexpr const command_entry* find (string_view name) const {
+         uint8_t index = slots[slot_of (seed, name)];
+         if (index == EMPTY) return nullptr;
+         const command_entry& entry = command_table[index];
+         return entry.name == name ? &entry : nullptr;
+      }
+   private:
+      uint32_t seed {};
+      uint8_t slots[SLOTS] {};
+      static constexpr size_t slot_of (uint32_t seed,
+                                       string_view name) {
+         uint32_t hash = 2166136261u ^ seed;
+         for (char chr: name) {
+            hash = (hash ^ static_cast<uint8_t> (chr)) * 16777619u;
+         }
+         return (hash ^ (hash >> 16)) & (SLOTS - 1);
+      }
+      constexpr bool try_seed (uint32_t candidate) {
+         for (auto& slot: slots) slot = EMPTY;
+         for (size_t index = 0; index < COMMAND_COUNT; ++index) {
+            string_view name = command_table[index].name;
+            size_t slot = slot_of (candidate, name);
+            if (slots[slot] != EMPTY) return false;
+            slots[slot] = static_cast<uint8_t> (index);
+         }
+         seed = candidate;
+         return true;
+      }
+};
+
+constexpr command_index cmd_index;
+
+static_assert (cmd_index.find ("lsr")->fn == fn_lsr);
+static_assert (cmd_index.find ("lsrx") == nullptr);
+
+command_id find_command (string_view command) {
+   DEBUGF ('c', "[" << command << "]");
+   const command_entry* entry = cmd_index.find (command);
+   if (entry == nullptr) {
+      throw command_error (string (command) + ": no such function");
+   }
+   return static_cast<command_id> (entry - command_table);
+}
+
+command_fn find_command_fn (string_view command) {
+   return command_table[find_command (command)].fn;
+}
+
+// command_latency -
+//    One histogram per row of command_table.
+
+static latency_histogram command_latency[COMMAND_COUNT];
+
+void run_command (command_id command, inode_state& state,
+                  const wordvec& words, latency_lap& lap) {
+   latency_timer timer (lap, command_latency[command]);
+   command_table[command].fn (state, words);
+}
+
+void print_command_stats (ostream& out) {
+   out << "   count    p50 us    p99 us    max us  total ms  command\n";
+   auto micros = [] (uint64_t nanos) { return nanos / 1e3; };
+   ios_base::fmtflags flags = out.flags();
+   streamsize precision = out.precision();
+   out << fixed << setprecision (1);
+   for (size_t command = 0; command < COMMAND_COUNT; ++command) {
+      const latency_histogram& times = command_latency[command];
+      if (times.count() == 0) continue;
+      out << setw (8) << times.count()
+          << setw (10) << micros (times.percentile (0.50))
+          << setw (10) << micros (times.percentile (0.99))
+          << setw (10) << micros (times.max())
+          << setw (10) << setprecision (3) << times.total() / 1e6
+          << setprecision (1) << "  " << command_table[command].name
+          << "\n";
+   }
+   out.flags (flags);
+   out.precision (precision);
+}
+
+void dump_command_stats (ostream& out) {
+   out << "command\tcount\tp50_ns\tp99_ns\tmax_ns\ttotal_ns\n";
+   for (size_t command = 0; command < COMMAND_COUNT; ++command) {
+      const latency_histogram& times = command_latency[command];
+      if (times.count() == 0) continue;
+      out << command_table[command].name << '\t' << times.count()
+          << '\t' << times.percentile (0.50)
+          << '\t' << times.percentile (0.99)
+          << '\t' << times.max() << '\t' << times.total() << '\n';
    }
-   return result->second;
 }
 
 command_error::command_error (const string& what):
@@ -37,10 +161,23 @@ command_error::command_error (const string& what):
 
 int exit_status_message() {
    int status = exec::status();
-   cout << exec::execname() << ": exit(" << status << ")" << endl;
+   cout << exec::execname() << ": exit(" << status << ")\n";
    return status;
 }
 
+void fn_allocstats (inode_state& state, const wordvec& words) {
+   slab_pool::report (cout);
+   state.print_reclaim_stats();
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_cachestats (inode_state& state, const wordvec& words) {
+   state.print_cache_stats();
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
 void fn_cat (inode_state& state, const wordvec& words) {
    if (words.size() > 1) {
      state.print_file(words);
@@ -52,11 +189,11 @@ void fn_cat (inode_state& state, const wordvec& words) {
 }
 
 void fn_cd (inode_state& state, const wordvec& words) {
-   wordvec names;
+   string_view pathname;
    if(words.size() > 1) {
-     names = split(words[1],"/");
+     pathname = words[1];
    }
-   state.change_directory(names);
+   state.change_directory(pathname);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
@@ -64,7 +201,7 @@ void fn_cd (inode_state& state, const wordvec& words) {
 void fn_echo (inode_state& state, const wordvec& words) {
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   cout << word_range (words.cbegin() + 1, words.cend()) << endl;
+   cout << word_range (words.cbegin() + 1, words.cend()) << '\n';
 }
 
 
@@ -91,34 +228,44 @@ void fn_exit (inode_state& state, const wordvec& words) {
    throw ysh_exit();
 }
 
+void fn_checkpoint (inode_state& state, const wordvec& words) {
+   state.checkpoint();
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_journalstats (inode_state& state, const wordvec& words) {
+   state.print_journal_stats();
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_load (inode_state& state, const wordvec& words) {
+   if(words.size() < 2) {
+     throw command_error("No file name");
+   }
+   state.load(words[1]);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
 void fn_ls (inode_state& state, const wordvec& words) {
-   wordvec names;
+   string_view pathname;
    if(words.size() > 1) {
-     if(words[1] == "/") {
-       //Nothing allow root to pass
-       names.push_back("/");
-     } else {
-       names = split(words[1],"/");
-     }
+     pathname = words[1];
    } 
 
-   state.list(names);
+   state.list(pathname);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
 
 void fn_lsr (inode_state& state, const wordvec& words) {
-   wordvec names;
+   string_view pathname;
    if(words.size() > 1) {
-     if(words.at(1) == "/") {
-        names.push_back("/");
-     }else{
-       names = split(words[1],"/");
-     }
-   } else {
-     names.push_back(".");
+     pathname = words[1];
    }
-   state.listr(names);
+   state.listr(pathname);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
@@ -133,14 +280,26 @@ void fn_make (inode_state& state, const wordvec& words) {
    DEBUGF ('c', words);
 }
 
+void fn_memstats (inode_state& state, const wordvec& words) {
+   name_table::report (cout);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
 void fn_mkdir (inode_state& state, const wordvec& words) {
-   wordvec names;
-   if(words.size() > 1) {
-     names = split(words[1],"/");
-   } else {
+   if(words.size() < 2) {
      throw command_error("No name input");
    }
-   state.make_directory(names);
+   state.make_directory(words[1]);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_mount (inode_state& state, const wordvec& words) {
+   if(words.size() < 2) {
+     throw command_error("No file name");
+   }
+   state.mount(words[1]);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
@@ -162,25 +321,46 @@ void fn_pwd (inode_state& state, const wordvec& words) {
 }
 
 void fn_rm (inode_state& state, const wordvec& words) {
-   wordvec names;
-   if(words.size() > 1) {
-     names = split(words[1],"/");
-   } else {
+   if(words.size() < 2) {
      throw command_error("No file name");
    }
-   state.remove_here(names);
+   state.remove_here(words[1]);
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
 
 void fn_rmr (inode_state& state, const wordvec& words) {
-   wordvec names;
-   if(words.size() > 1) {
-     names = split(words[1],"/");
-   } else {
+   if(words.size() < 2) {
+     throw command_error("No file name");
+   }
+   state.rmr(words[1]);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_rollback (inode_state& state, const wordvec& words) {
+   state.rollback();
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_save (inode_state& state, const wordvec& words) {
+   if(words.size() < 2) {
      throw command_error("No file name");
    }
-   state.rmr(names);
+   state.save(words[1]);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_stats (inode_state& state, const wordvec& words) {
+   print_command_stats (cout);
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+}
+
+void fn_sync (inode_state& state, const wordvec& words) {
+   state.sync();
    DEBUGF ('c', state);
    DEBUGF ('c', words);
 }
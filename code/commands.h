@@ -4,16 +4,18 @@
 #ifndef __COMMANDS_H__
 #define __COMMANDS_H__
 
-#include <unordered_map>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
 using namespace std;
 
 #include "file_sys.h"
+#include "latency.h"
 #include "util.h"
 
-// A couple of convenient usings to avoid verbosity.
+// A convenient using to avoid verbosity.
 
 using command_fn = void (*)(inode_state& state, const wordvec& words);
-using command_hash = unordered_map<string,command_fn>;
 
 // command_error -
 //    Extend runtime_error for throwing exceptions related to this 
@@ -26,20 +28,51 @@ class command_error: public runtime_error {
 
 // execution functions -
 
+void fn_allocstats (inode_state& state, const wordvec& words);
+void fn_cachestats (inode_state& state, const wordvec& words);
 void fn_cat    (inode_state& state, const wordvec& words);
 void fn_cd     (inode_state& state, const wordvec& words);
+void fn_checkpoint (inode_state& state, const wordvec& words);
 void fn_echo   (inode_state& state, const wordvec& words);
 void fn_exit   (inode_state& state, const wordvec& words);
+void fn_journalstats (inode_state& state, const wordvec& words);
+void fn_load   (inode_state& state, const wordvec& words);
 void fn_ls     (inode_state& state, const wordvec& words);
 void fn_lsr    (inode_state& state, const wordvec& words);
 void fn_make   (inode_state& state, const wordvec& words);
+void fn_memstats (inode_state& state, const wordvec& words);
 void fn_mkdir  (inode_state& state, const wordvec& words);
+void fn_mount  (inode_state& state, const wordvec& words);
 void fn_prompt (inode_state& state, const wordvec& words);
 void fn_pwd    (inode_state& state, const wordvec& words);
 void fn_rm     (inode_state& state, const wordvec& words);
 void fn_rmr    (inode_state& state, const wordvec& words);
+void fn_rollback (inode_state& state, const wordvec& words);
+void fn_save   (inode_state& state, const wordvec& words);
+void fn_stats  (inode_state& state, const wordvec& words);
+void fn_sync   (inode_state& state, const wordvec& words);
 
-command_fn find_command_fn (const string& command);
+// find_command, find_command_fn -
+//    Look up a builtin by name, as its place in the command table or
+//    as its function.  Throw command_error if there is no such
+//    builtin.
+// run_command -
+//    Calls the builtin and records the lap, which the caller started
+//    just before, in the builtin's latency histogram, whether it
+//    returns or throws.
+// print_command_stats, dump_command_stats -
+//    Count, p50, p99, max and total time of each builtin that has
+//    run.  print is a table for the stats builtin; dump is one tab
+//    separated line per builtin, in nanoseconds, under a header.
+
+using command_id = uint32_t;
+
+command_id find_command (string_view command);
+command_fn find_command_fn (string_view command);
+void run_command (command_id command, inode_state& state,
+                  const wordvec& words, latency_lap& lap);
+void print_command_stats (ostream& out);
+void dump_command_stats (ostream& out);
 
 // exit_status_message -
 //    Prints an exit message and returns the exit status, as recorded
@@ -0,0 +1,112 @@
+// $Id: dirbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// dirbench -
+//    Compares the directory backing stores in dirents.h.  For each
+//    directory size, times inserting, finding, iterating and erasing
+//    every entry in random order, and prints nanoseconds per entry.
+//    Small sizes are repeated so each row does about the same work.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "dirents.h"
+#include "names.h"
+
+using bench_clock = chrono::steady_clock;
+
+struct bench_times {
+   double insert {0};
+   double find {0};
+   double iterate {0};
+   double erase {0};
+};
+
+double nanos_since (bench_clock::time_point start, size_t ops) {
+   chrono::duration<double,nano> elapsed = bench_clock::now() - start;
+   return elapsed.count() / ops;
+}
+
+template <typename store_t>
+bench_times run (const vector<dirent_key>& keys, size_t reps) {
+   bench_times times;
+   size_t checksum = 0;
+   for (size_t rep = 0; rep < reps; ++rep) {
+      store_t store;
+      auto start = bench_clock::now();
+      for (size_t index = 0; index < keys.size(); ++index) {
+         store.insert_or_assign (keys[index], index);
+      }
+      times.insert += nanos_since (start, keys.size() * reps);
+      start = bench_clock::now();
+      for (dirent_key key: keys) checksum += *store.find (key);
+      times.find += nanos_since (start, keys.size() * reps);
+      start = bench_clock::now();
+      for (const auto& entry: store) checksum += entry.second;
+      times.iterate += nanos_since (start, keys.size() * reps);
+      start = bench_clock::now();
+      for (dirent_key key: keys) checksum += store.erase (key);
+      times.erase += nanos_since (start, keys.size() * reps);
+   }
+   if (checksum == 0) cerr << "dirbench: empty run" << endl;
+   return times;
+}
+
+// same_order -
+//    Sanity check that both stores iterate in the same order.
+
+bool same_order (const vector<dirent_key>& keys) {
+   map_dirents<size_t> tree;
+   flat_dirents<size_t> flat;
+   for (size_t index = 0; index < keys.size(); ++index) {
+      tree.insert_or_assign (keys[index], index);
+      flat.insert_or_assign (keys[index], index);
+   }
+   if (tree.size() != flat.size()) return false;
+   auto flat_itor = flat.begin();
+   for (const auto& entry: tree) {
+      if (not (entry.first == flat_itor->first)) return false;
+      ++flat_itor;
+   }
+   return true;
+}
+
+void print (const string& store, size_t entries,
+            const bench_times& times) {
+   cout << setw (9) << entries << "  " << left << setw (6) << store
+        << right << fixed << setprecision (1)
+        << setw (10) << times.insert << setw (10) << times.find
+        << setw (10) << times.iterate << setw (10) << times.erase
+        << endl;
+}
+
+int main() {
+   constexpr size_t TOTAL_WORK {1000000};
+   mt19937 random (1);
+   cout << "  entries  store     insert      find   iterate     erase"
+        << endl;
+   for (size_t entries: {10, 10000, 1000000}) {
+      vector<dirent_key> keys;
+      for (size_t index = 0; index < entries; ++index) {
+         name_id id = name_table::intern ("f" + to_string (index));
+         keys.emplace_back (id, index % 3 == 0);
+      }
+      shuffle (keys.begin(), keys.end(), random);
+      if (not same_order (keys)) {
+         cerr << "dirbench: stores disagree on order" << endl;
+         return EXIT_FAILURE;
+      }
+      size_t reps = max<size_t> (1, TOTAL_WORK / entries);
+      print ("map", entries, run<map_dirents<size_t>> (keys, reps));
+      print ("flat", entries, run<flat_dirents<size_t>> (keys, reps));
+   }
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,204 @@
+// $Id: dirents.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// dirents -
+//    Ordered containers mapping dirent keys to entries.  Both share
+//    one interface so a directory can be backed by either:
+//       find             - pointer to the entry, or nullptr
+//       insert_or_assign - add an entry or replace an existing one
+//       erase            - remove an entry, false if there was none
+//       size, begin, end - iteration is in dirent_less order
+//       drain            - move every entry out, leaving it empty
+//
+// map_dirents -
+//    A std::map, one heap node per entry.
+// flat_dirents -
+//    Sorted vectors of entries.  A small directory is one sorted
+//    vector.  When a block grows past BLOCK_MAX entries it is split,
+//    so a large directory becomes an ordered run of blocks indexed
+//    by their last keys:  a B-tree of height two.  Lookup is two
+//    binary searches and iteration walks contiguous memory.
+
+#ifndef __DIRENTS_H__
+#define __DIRENTS_H__
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "names.h"
+
+// dirent_less -
+//    Lexicographic ordering of dirent keys, with a subdirectory
+//    sorting as "name/".
+
+struct dirent_less {
+   bool operator() (dirent_key left, dirent_key right) const {
+      return compare (left, right) < 0;
+   }
+};
+
+template <typename mapped_t>
+class map_dirents {
+   private:
+      map<dirent_key,mapped_t,dirent_less> entries;
+   public:
+      using value_type = pair<const dirent_key,mapped_t>;
+      using const_iterator = typename map<dirent_key,mapped_t,
+                             dirent_less>::const_iterator;
+      const mapped_t* find (dirent_key key) const {
+         auto found = entries.find (key);
+         return found == entries.end() ? nullptr : &found->second;
+      }
+      void insert_or_assign (dirent_key key, const mapped_t& value) {
+         entries.insert_or_assign (key, value);
+      }
+      bool erase (dirent_key key) { return entries.erase (key) > 0; }
+      void drain (vector<mapped_t>& out) {
+         for (auto& entry: entries) out.push_back (move (entry.second));
+         entries.clear();
+      }
+      size_t size() const { return entries.size(); }
+      const_iterator begin() const { return entries.cbegin(); }
+      const_iterator end() const { return entries.cend(); }
+};
+
+template <typename mapped_t>
+class flat_dirents {
+   public:
+      using value_type = pair<dirent_key,mapped_t>;
+      static constexpr size_t BLOCK_MAX {256};
+   private:
+      using block = vector<value_type>;
+      vector<block> blocks;
+      size_t count {0};
+      size_t block_for (dirent_key key) const;
+      static typename block::const_iterator
+             position (const block& entries, dirent_key key);
+   public:
+      class const_iterator {
+         private:
+            const vector<block>* blocks;
+            size_t blk;
+            size_t pos;
+         public:
+            const_iterator (const vector<block>* blocks_,
+                            size_t blk_, size_t pos_):
+                  blocks (blocks_), blk (blk_), pos (pos_) {}
+            const value_type& operator*() const {
+               return (*blocks)[blk][pos];
+            }
+            const value_type* operator->() const {
+               return &(*blocks)[blk][pos];
+            }
+            const_iterator& operator++() {
+               if (++pos == (*blocks)[blk].size()) { ++blk; pos = 0; }
+               return *this;
+            }
+            bool operator== (const const_iterator& that) const {
+               return blk == that.blk and pos == that.pos;
+            }
+            bool operator!= (const const_iterator& that) const {
+               return not (*this == that);
+            }
+      };
+      const mapped_t* find (dirent_key key) const;
+      void insert_or_assign (dirent_key key, const mapped_t& value);
+      bool erase (dirent_key key);
+      void drain (vector<mapped_t>& out);
+      size_t size() const { return count; }
+      const_iterator begin() const { return {&blocks, 0, 0}; }
+      const_iterator end() const { return {&blocks, blocks.size(), 0}; }
+};
+
+// flat_dirents::block_for -
+//    Index of the first block whose last key is not less than key,
+//    which is the only block that can hold it.  blocks.size() if
+//    the key is past the end.
+
+template <typename mapped_t>
+size_t flat_dirents<mapped_t>::block_for (dirent_key key) const {
+   auto found = lower_bound (blocks.cbegin(), blocks.cend(), key,
+                 [] (const block& entries, dirent_key wanted) {
+                    return dirent_less() (entries.back().first, wanted);
+                 });
+   return found - blocks.cbegin();
+}
+
+template <typename mapped_t>
+typename flat_dirents<mapped_t>::block::const_iterator
+flat_dirents<mapped_t>::position (const block& entries,
+                                  dirent_key key) {
+   return lower_bound (entries.cbegin(), entries.cend(), key,
+          [] (const value_type& entry, dirent_key wanted) {
+             return dirent_less() (entry.first, wanted);
+          });
+}
+
+template <typename mapped_t>
+const mapped_t* flat_dirents<mapped_t>::find (dirent_key key) const {
+   size_t blk = block_for (key);
+   if (blk == blocks.size()) return nullptr;
+   auto found = position (blocks[blk], key);
+   if (found == blocks[blk].cend() or not (found->first == key)) {
+      return nullptr;
+   }
+   return &found->second;
+}
+
+template <typename mapped_t>
+void flat_dirents<mapped_t>::insert_or_assign (dirent_key key,
+                                               const mapped_t& value) {
+   if (blocks.empty()) {
+      blocks.emplace_back (1, value_type (key, value));
+      count = 1;
+      return;
+   }
+   size_t blk = min (block_for (key), blocks.size() - 1);
+   block& entries = blocks[blk];
+   auto found = position (entries, key);
+   size_t offset = found - entries.cbegin();
+   if (found != entries.cend() and found->first == key) {
+      entries[offset].second = value;
+      return;
+   }
+   entries.emplace (found, key, value);
+   ++count;
+   if (entries.size() > BLOCK_MAX) {
+      block upper (make_move_iterator (entries.begin() + BLOCK_MAX / 2),
+                   make_move_iterator (entries.end()));
+      entries.erase (entries.begin() + BLOCK_MAX / 2, entries.end());
+      blocks.insert (blocks.begin() + blk + 1, move (upper));
+   }
+}
+
+template <typename mapped_t>
+bool flat_dirents<mapped_t>::erase (dirent_key key) {
+   size_t blk = block_for (key);
+   if (blk == blocks.size()) return false;
+   block& entries = blocks[blk];
+   auto found = position (entries, key);
+   if (found == entries.cend() or not (found->first == key)) {
+      return false;
+   }
+   entries.erase (found);
+   --count;
+   if (entries.empty()) blocks.erase (blocks.begin() + blk);
+   return true;
+}
+
+template <typename mapped_t>
+void flat_dirents<mapped_t>::drain (vector<mapped_t>& out) {
+   for (block& entries: blocks) {
+      for (value_type& entry: entries) {
+         out.push_back (move (entry.second));
+      }
+   }
+   blocks.clear();
+   count = 0;
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+// $Id: dispatchbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// dispatchbench -
+//    Times resolving a command name to its function, once per
+//    command per line of input.  Compares find_command_fn against
+//    the unordered_map<string,command_fn> it replaced, which built
+//    a heap string from each word before hashing it, and prints
+//    nanoseconds per lookup for each command name.
+//    Usage:  dispatchbench [lookups]
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+
+using bench_clock = chrono::steady_clock;
+
+const vector<pair<string,command_fn>> commands {
+   {"allocstats", fn_allocstats},
+   {"cachestats", fn_cachestats},
+   {"cat"   , fn_cat   },
+   {"cd"    , fn_cd    },
+   {"echo"  , fn_echo  },
+   {"exit"  , fn_exit  },
+   {"ls"    , fn_ls    },
+   {"lsr"   , fn_lsr   },
+   {"make"  , fn_make  },
+   {"memstats", fn_memstats},
+   {"mkdir" , fn_mkdir },
+   {"prompt", fn_prompt},
+   {"pwd"   , fn_pwd   },
+   {"rm"    , fn_rm    },
+   {"rmr"   , fn_rmr   },
+   {"sync"  , fn_sync  },
+};
+
+double nanos_since (bench_clock::time_point start, size_t ops) {
+   chrono::duration<double,nano> elapsed = bench_clock::now() - start;
+   return elapsed.count() / ops;
+}
+
+// The words come from a line buffer, as they do in the shell, so
+// neither lookup can see the name as a constant.
+
+template <typename lookup_t>
+double time_lookup (string_view word, size_t reps,
+                    command_fn expect, lookup_t lookup) {
+   size_t misses = 0;
+   auto start = bench_clock::now();
+   for (size_t rep = 0; rep < reps; ++rep) {
+      string_view name = word;
+      asm volatile ("" : "+r" (name));
+      if (lookup (name) != expect) ++misses;
+   }
+   double nanos = nanos_since (start, reps);
+   if (misses != 0) cerr << "dispatchbench: " << word << " missed\n";
+   return nanos;
+}
+
+int main (int argc, char** argv) {
+   size_t reps = argc > 1 ? stoul (argv[1]) : 2000000;
+   unordered_map<string,command_fn> hash (commands.begin(),
+                                          commands.end());
+   auto by_hash = [&hash] (string_view name) {
+      return hash.find (string (name))->second;
+   };
+   auto by_index = [] (string_view name) {
+      return find_command_fn (name);
+   };
+   string line;
+   for (const auto& command: commands) line += command.first + " ";
+   cout << "  command    hash   index" << endl;
+   double hash_total = 0;
+   double index_total = 0;
+   size_t offset = 0;
+   for (const auto& command: commands) {
+      string_view word (line.data() + offset, command.first.size());
+      offset += command.first.size() + 1;
+      double hash_nanos = time_lookup (word, reps, command.second,
+                                       by_hash);
+      double index_nanos = time_lookup (word, reps, command.second,
+                                        by_index);
+      hash_total += hash_nanos;
+      index_total += index_nanos;
+      cout << setw (9) << command.first << fixed << setprecision (1)
+           << setw (8) << hash_nanos << setw (8) << index_nanos
+           << endl;
+   }
+   cout << setw (9) << "mean" << setw (8)
+        << hash_total / commands.size() << setw (8)
+        << index_total / commands.size() << endl;
+   return EXIT_SUCCESS;
+}
@@ -5,17 +5,24 @@
 #include <cassert>
 #include <iostream>
 #include <iterator>
-#include <stack>
 #include <stdexcept>
 #include <cstring>
-#include <iomanip>
+#include <unistd.h>
 
 using namespace std;
 
+#include "arena.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "listing.h"
+#include "output.h"
+#include "journal.h"
+#include "reclaim.h"
+#include "snapshot.h"
 
 size_t inode::next_inode_nr {1};
+uint32_t inode::current_epoch {1};
+atomic<size_t> inode::live_inodes {0};
 
 ostream& operator<< (ostream& out, file_type type) {
    switch (type) {
@@ -27,80 +34,126 @@ ostream& operator<< (ostream& out, file_type type) {
 }
 
 inode_state::inode_state() {
-   inode rut = inode(file_type::DIRECTORY_TYPE);
-   root = make_shared<inode>(rut);
-   root->name = "/";
-   root->contents->setup_dir(root, root);
+   root = inode::make(file_type::DIRECTORY_TYPE);
+   root->set_name("");
+   root->set_parent(root.get());
    cwd = root;
-   DEBUGF ('i', "root = " << root->name << ", cwd = " << cwd
+   reclaim = make_unique<reclaimer>();
+   DEBUGF ('i', "root = " << root->key() << ", cwd = " << cwd
          << ", prompt = \"" << prompt() << "\"");
 }
 
-void inode_state::make_directory(const wordvec& dirname) {
-  if(dirname.size() == 0) {
-    errors++;
-    throw file_error("ILLEGAL DIRECTORY PATH");
-    return;
-  }
-  inode_ptr path = directory_search(dirname, cwd, true);
-  if(path == nullptr) {
+inode_state::~inode_state() {
+   size_t freed = dismantle (move (root));
+   freed += dismantle (move (cwd));
+   while (not versions.empty()) {
+      freed += dismantle (move (versions.back().root));
+      freed += dismantle (move (versions.back().cwd));
+      versions.pop_back();
+   }
+   DEBUGF ('i', "freed " << freed << " inodes");
+}
+
+size_t dismantle (inode_ptr subtree) {
+   size_t freed = 0;
+   vector<inode_ptr> work;
+   work.push_back (move (subtree));
+   while (not work.empty()) {
+      inode_ptr node = move (work.back());
+      work.pop_back();
+      if (node.use_count() > 1) continue;
+      node->detach_lower (work);
+      ++freed;
+   }
+   return freed;
+}
+
+tree_walker::tree_walker (const inode_ptr& top, const string& path):
+             current (top), path_ (path) {
+}
+
+bool tree_walker::next() {
+   if (not started) {
+      started = true;
+      return current != nullptr;
+   }
+   if (descend and current != nullptr) {
+      const dirent_map& lower = current->get_lower();
+      size_t prefix = path_ == "/" ? 0 : path_.size();
+      stack.push_back ({lower.begin(), lower.end(), prefix});
+   }
+   descend = true;
+   current = nullptr;
+   while (not stack.empty()) {
+      cursor& top = stack.back();
+      while (top.next != top.end and not top.next->first.is_dir()) {
+         ++top.next;
+      }
+      if (top.next == top.end) {
+         stack.pop_back();
+         continue;
+      }
+      path_.resize (top.prefix);
+      path_.append ("/").append (top.next->first.name());
+      current = top.next->second;
+      ++top.next;
+      return true;
+   }
+   return false;
+}
+
+void inode_state::make_directory(string_view dirname) {
+  path_walk found = walk(dirname, cwd, true);
+  if(found.last.empty() or not found.found()) {
     errors++;
     throw file_error("ILLEGAL DIRECTORY PATH");
     return;
   }
-  string name = dirname[dirname.size()-1];
-  map<string, inode_wk_ptr> parent = path->get_higher();
-  map<string, inode_ptr> children = path->get_lower();
-  map<string, inode_ptr> :: iterator it;
-  it = children.find(name);
-  if(it != children.end()) {
+  inode_ptr path = found.node;
+  if(path->find_lower(found.last) != nullptr
+     or path->find_lower_dir(found.last) != nullptr) {
     errors++;
     throw file_error("ILLEGAL DIRECTORY PATH");
     return;
   }
-  name = name + "/";
-  it = children.find(name);
-  if(it != children.end()) {
-    errors++;
-    throw file_error("ILLEGAL DIRECTORY PATH");
-  }
-  inode_ptr n_dir=path->contents->mkdir(name);
-  n_dir->contents->setup_dir(n_dir, path);
-  children.insert(pair<string, inode_ptr>(n_dir->name, n_dir));
-  path->set_lower(children);
+  path = writable(path);
+  inode_ptr n_dir=path->contents->mkdir(found.last);
+  n_dir->set_parent(path.get());
+  path->add_lower(n_dir);
+  journal_change(journal_op::MKDIR, dirname);
 }
 
-void inode_state::change_directory(const wordvec& dirname) {
+void inode_state::change_directory(string_view dirname) {
+  inode_ptr old_cwd = cwd;
   if(dirname.size() == 0) {
     cwd = root;
+    cwd_path.clear();
   } else {
-    inode_ptr temp = directory_search(dirname, cwd, false);
-    if(temp != NULL) {
-      cwd = temp;
+    path_walk found = walk(dirname, cwd, false);
+    if(found.found()) {
+      cwd = found.node;
+      cwd_path.clear();
     } else {
       errors++;
       throw file_error("No such directory");
     }
   }
+  leave_cwd(move(old_cwd));
+  journal_change(journal_op::CD, dirname);
 }
 
 void inode_state::make_file(const wordvec& words) {
-  wordvec path = split(words.at(1), "/"); // get path
-  DEBUGF('f', "path: " << path);
+  path_walk found = walk(words.at(1), cwd, true);
+  DEBUGF('f', "path: " << words.at(1));
 
-  wordvec n_data; // data to write to new file with "" if none
+  // data to write to the file, empty if none
+  word_range n_data (words.cbegin() + min<size_t>(words.size(), 2),
+                     words.cend());
   DEBUGF('f', "data: " << n_data);
-  if (words.size() > 2) {
-    for (size_t i = 2; i != words.size(); ++i) {
-      n_data.push_back(words.at(i));
-    }
-  } else {
-    n_data.push_back("");
-  }
   
-  inode_ptr temp = directory_search(path, cwd, true);
+  inode_ptr temp = found.node;
   DEBUGF('f', "temp made: " << temp);
-  if (temp == nullptr)
+  if (found.last.empty() or not found.found())
   {
     errors++;
     throw file_error("ILLEGAL DIRECTORY PATH");
@@ -108,95 +161,135 @@ void inode_state::make_file(const wordvec& words) {
   }
 
 
-  map<string, inode_ptr> children = temp->get_lower();
-
-  if (children.find(path.at(path.size()-1) + "/") != children.end()) {
+  if (temp->find_lower_dir(found.last) != nullptr) {
     errors++;
     throw file_error("Directory with same name already present.");
   }
 
-  if (children.find(path[path.size()-1]) != children.end()) {
-    temp = children[path.at(path.size()-1)];
-    temp->contents->writefile(n_data);
+  word_range logged (words.cbegin() + 1, words.cend());
+  inode_ptr existing = temp->find_lower(found.last);
+  if (existing != nullptr) {
+    existing = writable(existing);
+    existing->contents->writefile(n_data);
+    journal_change(journal_op::MAKE, logged);
     return;
   }
 
-  inode_ptr n_file = temp->contents->mkfile(path[path.size() - 1]);
+  temp = writable(temp);
+  inode_ptr n_file = temp->contents->mkfile(found.last);
   DEBUGF('f', "n_file: " <<  n_file);
   n_file->contents->writefile(n_data);
+  n_file->set_parent(temp.get());
   
-  children.insert(pair<string, inode_ptr>(n_file->name, n_file));
-  temp->set_lower(children);
-  
+  temp->add_lower(n_file);
+  journal_change(journal_op::MAKE, logged);
 }
 
 void inode_state::print_file(const wordvec& words) {
   for (size_t i = 1; i < words.size(); i++) {
-    wordvec path = split(words.at(i), "/");
-    inode_ptr file_ptr = directory_search(path, cwd, true);
-
-    map<string, inode_ptr> child = file_ptr->get_lower();
-    map<string,inode_ptr>::iterator it;
-    it = child.find(path.at(path.size()-1));
+    path_walk found = walk(words.at(i), cwd, true);
+    inode_ptr file_ptr = nullptr;
+    if(found.found() and not found.last.empty()) {
+      file_ptr = found.node->find_lower(found.last);
+    }
     //Illegal path
-    if(it == child.end()) {
+    if(file_ptr == nullptr) {
       errors++;
-      throw file_error("cat: " +path[path.size()-1]
+      throw file_error("cat: " + string(found.last)
                    +": No such file or directory");
       return;
     }
-    file_ptr = child[path.at(path.size()-1)];
     DEBUGF('r', file_ptr);
 
-    wordvec file_data = file_ptr->contents->readfile();
+    string_view file_data = file_ptr->contents->readfile();
+    cout.write(file_data.data(), file_data.size());
+    cout << " \n";
+  }
+}
+
+// walk_step -
+//    Moves one pathname component down (or up) from a directory.
+//    Returns nullptr if there is no such subdirectory.
 
-    for(auto word : file_data) {
-      cout << word << " ";
+inode_ptr walk_step(const inode_ptr& curr, string_view name) {
+  if(name == ".") return curr;
+  if(name == "..") return curr->get_parent();
+  return curr->find_lower_dir(name);
+}
+
+path_walk inode_state::walk(string_view pathname, inode_ptr curr,
+                            bool make) {
+  path_walk result;
+  if(not pathname.empty() and pathname.front() == '/') curr = root;
+  if(make) {
+    size_t end = pathname.find_last_not_of('/');
+    if(end != string_view::npos) {
+      size_t start = pathname.find_last_of('/', end);
+      start = start == string_view::npos ? 0 : start + 1;
+      result.last = pathname.substr(start, end - start + 1);
+      pathname = pathname.substr(0, start);
     }
-    cout << endl;
   }
-}
 
-inode_ptr inode_state::directory_search(const wordvec& input,
-                                             inode_ptr curr, bool make){
-  int x = make ? 1 : 0;
-  for(int i = 0;i < static_cast<int>(input.size()) - x;i++) {
-    map<string, inode_wk_ptr> parent = curr->get_higher();
-    map<string,inode_ptr> child = curr->get_lower();
-    string name = input[i] + "/";
-    if("../" == name || "./" == name) {
-      curr = parent[name].lock();
-    } else {
-      map<string,inode_ptr>::iterator it;
-      it = child.find(name);
-      //Illegal path
-      if(it == child.end()) {
-        return nullptr;
-      }
-      curr = child[name];
+  // Trim the slashes so "a/b" and "/a/b/" share a cache entry.
+  size_t first = pathname.find_first_not_of('/');
+  if(first == string_view::npos) {
+    result.node = curr;
+    return result;
+  }
+  size_t last = pathname.find_last_not_of('/');
+  pathname = pathname.substr(first, last - first + 1);
+  size_t start_nr = curr->get_inode_nr();
+  inode_ptr cached = cache.find(start_nr, pathname, result.depth);
+  if(cached != nullptr) {
+    result.node = cached;
+    return result;
+  }
+  string_view dirpath = pathname;
+
+  for(;;) {
+    size_t start = pathname.find_first_not_of('/');
+    if(start == string_view::npos) break;
+    size_t end = min(pathname.find('/', start), pathname.size());
+    string_view name = pathname.substr(start, end - start);
+    pathname.remove_prefix(end);
+    inode_ptr next = walk_step(curr, name);
+    //Illegal path
+    if(next == nullptr) {
+      result.failed = name;
+      break;
     }
+    curr = move(next);
+    ++result.depth;
+  }
+  result.node = curr;
+  if(result.found()) {
+    cache.insert(start_nr, dirpath, curr, result.depth);
   }
-  return curr;
+  DEBUGF('f', "depth = " << result.depth << ", failed = "
+         << result.failed << ", last = " << result.last);
+  return result;
 }
 
-void inode_state::list(const wordvec& path) {
-  inode_ptr curr;
-  if(path.size() == 0) {
-    curr = cwd;
-  } else if(path[0] == "/") {
-    curr = root;
-  } else {
-    curr = directory_search(path, cwd, false);
-  }
+inode_ptr inode_state::directory_search(string_view pathname,
+                                        inode_ptr curr, bool make) {
+  path_walk found = walk(pathname, curr, make);
+  return found.found() ? found.node : nullptr;
+}
+
+void inode_state::list(string_view pathname) {
+  wordvec path = pathname == "/" ? wordvec {"/"} : split(pathname, "/");
+  inode_ptr curr = directory_search(pathname, cwd, false);
   if(curr == nullptr) {
-    string name = path[path.size()-1];
-    curr = directory_search(path, cwd, true);
-    map<string, inode_ptr>children = curr->get_lower();
-    map<string,inode_ptr> :: iterator it;
-    it = children.find(name);
-    if(it != children.end()) {
-      cout<< "     " << children[name]->get_inode_nr() << setw(8) << 
-      children[name]->contents->size() <<"  " << name << endl;
+    path_walk found = walk(pathname, cwd, true);
+    string name(found.last);
+    inode_ptr file = nullptr;
+    if(found.found() and not name.empty()) {
+      file = found.node->find_lower(name);
+    }
+    if(file != nullptr) {
+      row_formatter rows;
+      rows.put(cout, file->get_inode_nr(), file->size(), name);
       return;
     } else {
       errors++;
@@ -204,21 +297,36 @@ void inode_state::list(const wordvec& path) {
     }
   }
   
+  string text;
   if(path.size() == 0) {
-    string header = cwd->name.substr(0,cwd->name.size()-1);
-    if(header == "/") {
-      cout << header;
-    } else {
-      cout << "/" << header;
-    }
+    text.append("/").append(cwd->key().name());
   } else if(path.size() == 1) {
-    cout << path[0];
+    text.append(path[0]);
   } else {
     for(auto &path_elem:path) {
-      cout << "/"<< path_elem;
+      text.append("/").append(path_elem);
     }
   }
-  cout << ":"<<endl;
+  text.append(":\n");
+
+  row_formatter rows;
+  render_rows(text, rows, curr);
+  cout.write(text.data(), static_cast<streamsize>(text.size()));
+}
+
+void inode_state::listr(string_view pathname) {
+  string path;
+  if(pathname.empty()) {
+    path = "/.";
+  } else if(pathname == "/") {
+    path = "/";
+  } else {
+    for(auto &path_elem:split(pathname, "/")) {
+      path.append("/").append(path_elem);
+    }
+  }
+  inode_ptr curr = directory_search(pathname.empty() ? "." : pathname,
+                                    cwd, false);
   
   if(curr == nullptr) {
     errors++;
@@ -226,134 +334,111 @@ void inode_state::list(const wordvec& path) {
     return;
   }
 
-  map<string, inode_wk_ptr> parent = curr->get_higher();
-  map<string, inode_ptr> children = curr->get_lower();
-
-  for(auto pair = parent.rbegin();pair != parent.rend();pair++) {
-    string name = pair->first;
-    inode_ptr par = parent[name].lock();
-    cout<<"     " << par->get_inode_nr() << setw(8) << 
-    par->get_lower().size() + 2 << "  " << name <<  endl;
-  }
+  list_tree(cout, curr, path, lsr_jobs);
+}
 
-  for(auto const &pair:children) {
-    string name = pair.first;
-    if(children[name]->type() == "p") {
-      cout<< "     " << children[name]->get_inode_nr() << setw(8) 
-      << children[name]->contents->size() <<"  " << name << endl;
-    } else {
-      map<string, inode_ptr> children2 = children[name]->get_lower();
-      cout <<"     "<< children[name]->get_inode_nr() << setw(8) 
-      << children2.size() + 2 << "  " << name << endl;
-    }
-  }
+void inode_state::set_lsr_jobs(size_t jobs) {
+  lsr_jobs = jobs;
 }
 
-void inode_state::print_recursive(inode_ptr curr, wordvec path) {
-  wordvec n_path = path;
-  for (auto &path_elem : path) {
-    if(path_elem != "/") {
-      cout<< "/" << path_elem;
-    }else if(path.size() == 1){
-      cout << "/";
-    }
+// inode_state::working_directory -
+//    The absolute path of cwd, followed by a newline.  Computed by
+//    walking up to the root the first time it is wanted after cwd
+//    changes or a directory is removed, and reused until then.
+
+const string& inode_state::working_directory() {
+  if(not cwd_path.empty()) return cwd_path;
+  vector<string_view> names;
+  for(inode_ptr curr = cwd; curr != root and curr != nullptr;
+      curr = curr->get_parent()) {
+    names.push_back(curr->key().name());
   }
-  cout << ":" << endl;
-  map<string, inode_wk_ptr> parent = curr->get_higher();
-  map<string, inode_ptr> children = curr->get_lower();
-  for(auto pair = parent.rbegin();pair != parent.rend();pair++) {
-    string name = pair->first;
-    inode_ptr par = parent[name].lock();
-    cout<<"     " << par->get_inode_nr() << setw(8) 
-    << par->get_lower().size() + 2 << "  " << name <<  endl;
-  }
-  for(auto const &pair:children) {
-    string name = pair.first;
-    if(children[name]->type() == "p") {
-      cout<< "     " << children[name]->get_inode_nr() << setw(8) 
-      << children[name]->contents->size() <<"  " << name << endl;
-    } else {
-      map<string, inode_ptr> children2 = children[name]->get_lower();
-      cout <<"     "<< children[name]->get_inode_nr() << setw(8) 
-      << children2.size() + 2 << "  " << name << endl;
-    }
-  }
-  
-  for(auto const &n : children) {
-    string name = n.first;
-    if (children[name]->type() == "d") {
-      wordvec temp = split(name, "/");
-      n_path.push_back(temp.at(0));
-      print_recursive(n.second, n_path);
-      n_path.pop_back();
-    }
+  if(names.empty()) cwd_path = "/";
+  for(auto name = names.rbegin(); name != names.rend(); ++name) {
+    cwd_path.append("/").append(*name);
   }
+  cwd_path.push_back('\n');
+  return cwd_path;
 }
 
-void inode_state::listr(const wordvec& path) {
-  inode_ptr curr;
-  wordvec n_path = path;
-  if(path.size() == 0) {
-    curr = cwd;
-  } else if(path[0] == "/" && path.size() == 1) {
-    curr = root;
-    n_path.pop_back();
-  } else {
-    curr = directory_search(path, cwd, false);
-  }
-  
-  if(curr == nullptr) {
+void inode_state::print_working_directory() {
+  const string& path = working_directory();
+  cout.write(path.data(), static_cast<streamsize>(path.size()));
+}
+
+void inode_state::remove_here(string_view pathname) {
+  path_walk found = walk(pathname, cwd, true);
+  if(found.last.empty() or not found.found()) {
     errors++;
     throw file_error("ILLEGAL DIRECTORY PATH");
+  }
+  inode_ptr curr = found.node;
+  inode_ptr temp = curr->find_lower(found.last);
+  if(temp != nullptr) {
+    curr = writable(curr);
+    curr->erase_lower(found.last, false);
+    discard(move(temp));
+    journal_change(journal_op::RM, pathname);
     return;
   }
-
-  print_recursive(curr, path);
-  return;
-
+  temp = curr->find_lower_dir(found.last);
+  if(temp != nullptr and temp->get_lower().size() == 0) {
+    curr = writable(curr);
+    detach_cwd(temp);
+    curr->erase_lower(found.last, true);
+    cache.clear();
+    cwd_path.clear();
+    if(temp != cwd) discard(move(temp));
+    journal_change(journal_op::RM, pathname);
+  }
 }
 
-void inode_state::print_working_directory() {
-  if(cwd == root) {
-    cout << root->name << endl;
+// inode_state::detach_cwd -
+//    Called before the directory dir is unlinked, or dropped once a
+//    removed cwd is left behind.  If cwd is dir or lies below it,
+//    cwd is unlinked from its own directory first and loses its
+//    dotdot.  cwd then owns itself and everything under it, and
+//    nothing the reclaimer frees is still in use here.  A frozen
+//    dotdot is left alone, since the saved version still needs the
+//    entry and keeps the directory alive.
+
+void inode_state::detach_cwd(const inode_ptr& dir) {
+  for(inode* curr = cwd.get(); curr != nullptr and curr != root.get();
+      curr = curr->get_parent()) {
+    if(curr != dir.get()) continue;
+    inode* dotdot = cwd->get_parent();
+    if(dotdot != nullptr and not frozen(dotdot)) {
+      dotdot->erase_lower(cwd->key().name(), true);
+    }
+    set_dotdot(cwd.get(), nullptr);
     return;
   }
-  stack<string> path;
-  path.push(cwd->name);
-  inode_ptr curr = cwd;
-  while(curr != root) {
-    map<string, inode_wk_ptr> parent = curr->get_higher();
-    curr = parent["../"].lock();
-    path.push(curr->name);
-  }
-  string add = "";
-  while(!path.empty()) {
-    add += path.top();
-    path.pop();
-  }
-  cout << add.substr(0,add.size()-1) << endl;
 }
 
-void inode_state::remove_here(const wordvec& path) {
-  inode_ptr curr = directory_search(path, cwd, true);
-  map<string, inode_ptr> children = curr->get_lower();
+// inode_state::discard -
+//    Frees a subtree that has been unlinked.  With no version saved
+//    the subtree is this state's alone and goes to the reclaimer.
+//    Otherwise a version may share parts of it, so it is dismantled
+//    here, which frees only what nothing else holds.
 
-  map<string,inode_ptr> :: iterator it;
-  string name = path[path.size()-1];
-  it = children.find(name);
-  
-  if(it!=children.end()) {
-    children.erase(name);
+void inode_state::discard(inode_ptr subtree) {
+  if(versions.empty()) {
+    reclaim->retire(move(subtree));
   } else {
-    name = name + "/";
-    it = children.find(name); 
-    if(it!=children.end()) {
-      inode_ptr temp = children[name];
-      map<string, inode_ptr> empty = temp->get_lower();
-      if(empty.size() == 0) children.erase(name);
-    }
+    dismantle(move(subtree));
   }
-  curr->set_lower(children);
+}
+
+// inode_state::leave_cwd -
+//    Called once cwd has moved off old_cwd.  A removed cwd owns all
+//    that is left under it.  A new cwd below it is detached in its
+//    turn, and the rest goes to the reclaimer rather than being
+//    freed here, recursively.
+
+void inode_state::leave_cwd(inode_ptr old_cwd) {
+  if(old_cwd == cwd or old_cwd->get_parent() != nullptr) return;
+  detach_cwd(old_cwd);
+  discard(move(old_cwd));
 }
 
 const string& inode_state::prompt() const { return prompt_; }
@@ -362,7 +447,7 @@ void inode_state::set_prompt(const wordvec& words) {
   string new_prompt{""};
   auto word = ++words.cbegin();
   for (; word != words.cend(); ++word) {
-    new_prompt.append(*word + " ");
+    new_prompt.append(*word).append(" ");
   }
   prompt_ = new_prompt;
 }
@@ -373,62 +458,474 @@ ostream& operator<< (ostream& out, const inode_state& state) {
    return out;
 }
 
-void inode_state::rmr(const wordvec& path) {
-  inode_ptr curr = directory_search(path, cwd, true);
-  map<string, inode_ptr> children = curr->get_lower();
-
-  map<string,inode_ptr> :: iterator it;
-  string name = path[path.size()-1];
-  it = children.find(name);
-  
-  if(it!=children.end()) {
-    children.erase(name);
-  } else {
-    name = name + "/";
-    it = children.find(name); 
-    if(it!=children.end()) {
-      children.erase(name);
+void inode_state::rmr(string_view pathname) {
+  path_walk found = walk(pathname, cwd, true);
+  if(found.last.empty() or not found.found()) {
+    errors++;
+    throw file_error("ILLEGAL DIRECTORY PATH");
+  }
+  inode_ptr curr = found.node;
+  bool is_dir = false;
+  inode_ptr target = curr->find_lower(found.last);
+  if(target == nullptr) {
+    is_dir = true;
+    target = curr->find_lower_dir(found.last);
+  }
+  if(target != nullptr) {
+    curr = writable(curr);
+    if(is_dir) detach_cwd(target);
+    curr->erase_lower(found.last, is_dir);
+    if(is_dir) {
+      cache.clear();
+      cwd_path.clear();
     }
+    if(target != cwd) discard(move(target));
+    journal_change(journal_op::RMR, pathname);
   }
-  curr->set_lower(children);
 }
 
 int inode_state::get_errors() {
   return errors;
 }
 
-inode::inode(file_type type): inode_nr (next_inode_nr++) {
-   switch (type) {
-      case file_type::PLAIN_TYPE:
-           contents = make_shared<plain_file>();
-           break;
-      case file_type::DIRECTORY_TYPE:
-           contents = make_shared<directory>();
-           break;
-      default: assert (false);
+void inode_state::sync() {
+  reclaim->sync();
+  if(log == nullptr) return;
+  try {
+    log->sync();
+  }catch (file_error& error) {
+    close_journal(error);
+  }
+}
+
+void inode_state::print_reclaim_stats() {
+  cout << "reclaim: " << reclaim->queued() << " subtrees queued, "
+       << reclaim->pending_bytes() << " bytes pending, "
+       << reclaim->freed_inodes() << " inodes freed\n";
+}
+
+// inode_state::save, load, mount -
+//    load and mount replace the whole tree.  cwd goes back to the
+//    root, and the old tree is handed to the reclaimer like a
+//    removed subtree.
+
+void inode_state::save(string_view filename) {
+  try {
+    write_snapshot(string(filename), 0);
+  }catch (file_error&) {
+    errors++;
+    throw;
+  }
+}
+
+void inode_state::load(string_view filename) {
+  try {
+    refuse_with_versions();
+    replace_tree(load_snapshot(string(filename)));
+  }catch (file_error&) {
+    errors++;
+    throw;
+  }
+}
+
+void inode_state::mount(string_view filename) {
+  try {
+    refuse_with_versions();
+    replace_tree(mount_snapshot(string(filename)));
+  }catch (file_error&) {
+    errors++;
+    throw;
+  }
+}
+
+void inode_state::refuse_with_versions() const {
+  if(not versions.empty()) {
+    throw file_error("not while a checkpoint is saved");
+  }
+}
+
+// inode_state::frozen -
+//    Whether node may be shared with the newest saved version.
+
+bool inode_state::frozen(const inode* node) const {
+  return not versions.empty() and node->epoch <= versions.back().epoch;
+}
+
+void inode_state::set_dotdot(inode* node, inode* dotdot) {
+  if(frozen(node)) {
+    versions.back().dotdots.emplace_back(node, node->get_parent());
+  }
+  node->set_parent(dotdot);
+}
+
+inode_ptr inode_state::writable(const inode_ptr& node) {
+  if(not frozen(node.get())) return node;
+  // node and its frozen directories, up to the first writable one
+  vector<inode*> path;
+  inode* above = node.get();
+  while(above != nullptr and frozen(above)) {
+    path.push_back(above);
+    above = above == root.get() ? nullptr : above->get_parent();
+  }
+  inode_ptr copy;
+  for(auto old = path.rbegin(); old != path.rend(); ++old) {
+    copy = (*old)->clone();
+    if(copy->ftype == file_type::DIRECTORY_TYPE) {
+      for(const auto& child: copy->get_lower()) {
+        set_dotdot(child.second.get(), copy.get());
+      }
+    }
+    if(*old == root.get()) {
+      copy->set_parent(copy.get());
+      root = copy;
+    }else {
+      copy->set_parent(above);
+      if(above != nullptr) above->add_lower(copy);
+    }
+    if(*old == cwd.get()) cwd = copy;
+    above = copy.get();
+  }
+  cache.clear();
+  DEBUGF('v', "copied " << path.size() << " inodes");
+  return copy;
+}
+
+void inode_state::checkpoint() {
+  versions.push_back({root, cwd, inode::current_epoch++, {}});
+  DEBUGF('v', "version " << versions.size() << ", epoch "
+         << versions.back().epoch);
+  journal_change(journal_op::CHECKPOINT, "");
+}
+
+void inode_state::rollback() {
+  if(versions.empty()) {
+    errors++;
+    throw file_error("No checkpoint");
+  }
+  version& saved = versions.back();
+  for(auto undo = saved.dotdots.rbegin(); undo != saved.dotdots.rend();
+      ++undo) {
+    undo->first->set_parent(undo->second);
+  }
+  inode_ptr old_root = move(root);
+  inode_ptr old_cwd = move(cwd);
+  root = move(saved.root);
+  cwd = move(saved.cwd);
+  versions.pop_back();
+  // Nothing is copied until something changes, so the same root and
+  // cwd mean the same tree.  Otherwise the old tree shares all that
+  // did not change with the one put back, so it is dismantled here:
+  // only the copies and what was made since the checkpoint are
+  // freed, and the reclaimer never sees an inode still in use.
+  if(old_root != root or old_cwd != cwd) {
+    cache.clear();
+    cwd_path.clear();
+    dismantle(move(old_root));
+    dismantle(move(old_cwd));
+  }
+  DEBUGF('v', versions.size() << " versions left");
+  journal_change(journal_op::ROLLBACK, "");
+}
+
+void inode_state::replace_tree(inode_ptr top) {
+  inode_ptr old = move(root);
+  inode_ptr old_cwd = move(cwd);
+  root = move(top);
+  cwd = root;
+  cache.clear();
+  cwd_path.clear();
+  leave_cwd(move(old_cwd));
+  discard(move(old));
+  if(log != nullptr) compact_journal();
+}
+
+void inode_state::open_journal(const string& base) {
+  string snapshot = base + ".snap";
+  uint64_t seq = 0;
+  if(access(snapshot.c_str(), F_OK) == 0) {
+    replace_tree(load_snapshot(snapshot, &seq));
+  }
+  try {
+    log = make_unique<journal>(base + ".jnl", seq,
+          [this] (journal_op op, const wordvec& words) {
+            replay_change(op, words);
+          });
+  }catch (file_error&) {
+    errors++;
+    throw;
+  }
+  journal_base = base;
+}
+
+// inode_state::journal_change -
+//    Logs a change that has just succeeded, if there is a journal,
+//    and checkpoints when the journal says it is time.
+
+void inode_state::journal_change(journal_op op, string_view path) {
+  if(log == nullptr) return;
+  log_words.clear();
+  if(not path.empty()) log_words.push_back(path);
+  journal_change(op, {log_words.cbegin(), log_words.cend()});
+}
+
+void inode_state::journal_change(journal_op op, word_range words) {
+  if(log == nullptr) return;
+  try {
+    log->append(op, words);
+  }catch (file_error& error) {
+    close_journal(error);
+    return;
+  }
+  if(log->due()) compact_journal();
+}
+
+// inode_state::close_journal -
+//    A journal that failed to commit or to checkpoint can no longer
+//    be trusted to replay, so it is closed and the shell carries on
+//    without one.  The change that found the failure has been made;
+//    only its record is lost.
+
+void inode_state::close_journal(const file_error& error) {
+  complain() << error.what() << ": journal closed, changes from "
+             << "here on are not logged" << endl;
+  log.reset();
+}
+
+void inode_state::replay_change(journal_op op, const wordvec& words) {
+  bool bare = op == journal_op::CD or op == journal_op::CHECKPOINT
+              or op == journal_op::ROLLBACK;
+  if(not bare and words.empty()) {
+    throw file_error("empty journal record");
+  }
+  switch(op) {
+    case journal_op::MKDIR: make_directory(words[0]); break;
+    case journal_op::MAKE: {
+      wordvec args {"make"};
+      args.insert(args.end(), words.cbegin(), words.cend());
+      make_file(args);
+      break;
+    }
+    case journal_op::RM: remove_here(words[0]); break;
+    case journal_op::RMR: rmr(words[0]); break;
+    case journal_op::CD:
+      change_directory(words.empty() ? "" : words[0]);
+      break;
+    case journal_op::CHECKPOINT: checkpoint(); break;
+    case journal_op::ROLLBACK: rollback(); break;
+  }
+}
+
+// inode_state::write_snapshot -
+//    A mounted tree is saved by copying its image, so a save or a
+//    checkpoint after mount does not expand every directory.
+
+void inode_state::write_snapshot(const string& filename,
+                                 uint64_t journal_seq) {
+  auto mounted = dynamic_cast<const mounted_directory*>
+                 (root->contents.get());
+  if(mounted == nullptr
+     or not mounted->save_image(filename, journal_seq)) {
+    save_snapshot(filename, root, journal_seq);
+  }
+}
+
+// inode_state::compact_journal -
+//    Saves the tree as of the last record, starts a new journal,
+//    and logs a cd back to cwd, since a snapshot has no cwd.  Not
+//    while a version is saved:  a snapshot holds only the live
+//    tree, so a later rollback could not be replayed.
+
+void inode_state::compact_journal() {
+  if(not versions.empty()) return;
+  if(cwd != root and cwd->get_parent() == nullptr) return;
+  try {
+    log->sync();
+    write_snapshot(journal_base + ".snap", log->sequence());
+    log->restart();
+  }catch (file_error& error) {
+    close_journal(error);
+    return;
+  }
+  DEBUGF('j', "checkpoint at " << log->sequence());
+  if(cwd != root) {
+    string path = working_directory();
+    path.pop_back();
+    journal_change(journal_op::CD, path);
+  }
+}
+
+void inode_state::print_journal_stats() {
+  if(log == nullptr) {
+    cout << "journal: off\n";
+    return;
+  }
+  log->report(cout);
+}
+
+void inode_state::print_cache_stats() {
+  cout << "path cache: " << cache.hits() << " hits, "
+       << cache.misses() << " misses, " << cache.size()
+       << " entries\n";
+}
+
+path_cache::path_cache (size_t capacity): slots (capacity) {
+}
+
+// path_cache::slot_for -
+//    Direct-mapped: each key has exactly one slot, and a colliding
+//    insert simply evicts the previous occupant.
+
+path_cache::entry& path_cache::slot_for (size_t dir_nr,
+                                         string_view path) {
+   size_t key = hash<string_view>{} (path) ^ (dir_nr * 0x9E3779B9);
+   return slots[key % slots.size()];
+}
+
+inode_ptr path_cache::find (size_t dir_nr, string_view path,
+                            size_t& depth) {
+   entry& slot = slot_for (dir_nr, path);
+   if (slot.dir_nr == dir_nr and slot.path == path) {
+      inode_ptr node = slot.node;
+      if (node != nullptr) {
+         ++hits_;
+         depth = slot.depth;
+         return node;
+      }
+   }
+   ++misses_;
+   return nullptr;
+}
+
+void path_cache::insert (size_t dir_nr, string_view path,
+                         const inode_ptr& node, size_t depth) {
+   entry& slot = slot_for (dir_nr, path);
+   if (slot.dir_nr == 0) ++used;
+   slot.dir_nr = dir_nr;
+   slot.path.assign (path.data(), path.size());
+   slot.node = node.get();
+   slot.depth = depth;
+}
+
+void path_cache::clear() {
+   DEBUGF ('f', "dropping " << used << " entries");
+   for (entry& slot: slots) slot = entry();
+   used = 0;
+}
+
+inode::inode(file_type type): inode (type, next_inode_nr) {
+}
+
+inode::inode(file_type type, size_t nr, base_file_ptr data):
+             inode_nr (nr), ftype (type), epoch (current_epoch),
+             contents (move (data)) {
+   next_inode_nr = max (next_inode_nr, nr + 1);
+   if (contents == nullptr) {
+      switch (type) {
+         case file_type::PLAIN_TYPE:
+              contents = make_pooled<plain_file>();
+              break;
+         case file_type::DIRECTORY_TYPE:
+              contents = make_pooled<directory>();
+              break;
+         default: assert (false);
+      }
    }
+   ++live_inodes;
    DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
 }
 
+inode_ptr inode::clone() const {
+   inode_ptr copy = make (ftype, inode_nr, contents->clone());
+   if (named) copy->set_name (name);
+   return copy;
+}
+
+inode_ptr inode::make(file_type type) {
+   return pooled_new<inode>(type);
+}
+
+inode_ptr inode::make(file_type type, size_t nr, base_file_ptr data) {
+   return pooled_new<inode>(type, nr, move (data));
+}
+
+void inode::destroy(inode* node) {
+   pooled_delete(node);
+}
+
+ostream& operator<< (ostream& out, const inode_ptr& node) {
+   return out << static_cast<const void*> (node.get());
+}
+
+inode::~inode() {
+   --live_inodes;
+   if (named) {
+      name_table::release (name, ftype == file_type::DIRECTORY_TYPE);
+   }
+}
+
+size_t inode::footprint() const {
+   return sizeof (inode) + contents->footprint();
+}
+
+size_t inode::size() const {
+   return contents->size();
+}
+
 size_t inode::get_inode_nr() const {
    DEBUGF ('i', "inode = " << inode_nr);
    return inode_nr;
 }
 
-map<string, inode_wk_ptr> inode::get_higher() {
-  return contents->get_parent();
+const dirent_map& inode::get_lower() const {
+  return contents->get_children();
+}
+
+inode_ptr inode::find_lower(string_view dirent) const {
+  return contents->find_child(dirent);
 }
 
-map<string, inode_ptr> inode::get_lower() {
-  return contents->get_children();
+inode_ptr inode::find_lower_dir(string_view dirname) const {
+  return contents->find_subdir(dirname);
 }
 
-void inode::set_lower(const map<string, inode_ptr>& child) {
-  contents->set_children(child);
+void inode::add_lower(const inode_ptr& child) {
+  contents->add_child(child);
 }
 
-void inode::set_name(string input) {
-  name = input;
+bool inode::erase_lower(string_view dirent, bool is_dir) {
+  return contents->erase_child(dirent, is_dir);
+}
+
+void inode::detach_lower(vector<inode_ptr>& out) {
+  size_t first = out.size();
+  contents->detach_children(out);
+  for(size_t child = first; child < out.size(); ++child) {
+    if(out[child].use_count() == 1) out[child]->set_parent(nullptr);
+  }
+}
+
+void inode::set_name(string_view input) {
+  set_name(name_table::intern (input));
+}
+
+void inode::set_name(name_id id) {
+  bool is_dir = ftype == file_type::DIRECTORY_TYPE;
+  if (named) name_table::release (name, is_dir);
+  name = id;
+  named = true;
+  name_table::retain (name, is_dir);
+}
+
+dirent_key inode::key() const {
+  return dirent_key (name, ftype == file_type::DIRECTORY_TYPE);
+}
+
+string_view inode::read() const {
+  return contents->readfile();
+}
+
+void inode::write(word_range words) {
+  contents->writefile(words);
 }
 
 string inode::type() {
@@ -440,40 +937,51 @@ file_error::file_error (const string& what):
             runtime_error (what) {
 }
 
-const wordvec& base_file::readfile() const {
+base_file_ptr base_file::clone() const {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::writefile (const wordvec&) {
+string_view base_file::readfile() const {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::remove (const string&) {
+void base_file::writefile (word_range) {
    throw file_error ("is a " + error_file_type());
 }
 
-inode_ptr base_file::mkdir (const string&) {
+void base_file::remove (const string&) {
    throw file_error ("is a " + error_file_type());
 }
 
-inode_ptr base_file::mkfile (const string&) {
+inode_ptr base_file::mkdir (string_view) {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::setup_dir (const inode_ptr&, inode_ptr&) {
+inode_ptr base_file::mkfile (string_view) {
    throw file_error ("is a " + error_file_type());
 }
 
-map<string,inode_ptr> base_file::get_children() {
+const dirent_map& base_file::get_children() const {
   throw file_error ("is a " + error_file_type());
 }
 
-map<string,inode_wk_ptr> base_file::get_parent() {
-  throw file_error ("is a "+ error_file_type());
+inode_ptr base_file::find_child (string_view) const {
+  throw file_error ("is a " + error_file_type());
 }
 
-void base_file::set_children(const map<string,inode_ptr>&) {
-  throw file_error("is a " + error_file_type());
+inode_ptr base_file::find_subdir (string_view) const {
+  throw file_error ("is a " + error_file_type());
+}
+
+void base_file::add_child (const inode_ptr&) {
+  throw file_error ("is a " + error_file_type());
+}
+
+bool base_file::erase_child (string_view, bool) {
+  throw file_error ("is a " + error_file_type());
+}
+
+void base_file::detach_children (vector<inode_ptr>&) {
 }
 
 string base_file::get_type() {
@@ -486,76 +994,137 @@ string plain_file::get_type() {
   return "p";
 }
 
+size_t plain_file::footprint() const {
+   return sizeof (plain_file) + data.heap_bytes();
+}
+
 size_t plain_file::size() const {
-   size_t size {0};
-   for(auto word:data) {
-     size += word.length();
-   }
-   size += data.size() - 1;
-   DEBUGF ('i', "size = " << size);
-   return size;
+   DEBUGF ('i', "size = " << data.size());
+   return data.size();
 }
 
-inode_ptr plain_file::mkfile(const string& filename){
-  inode_ptr file_ptr = make_shared<inode>(file_type::PLAIN_TYPE);
+inode_ptr plain_file::mkfile(string_view filename){
+  inode_ptr file_ptr = inode::make(file_type::PLAIN_TYPE);
   file_ptr->set_name(filename);
   DEBUGF('i', filename);
   return file_ptr;
 }
 
-const wordvec& plain_file::readfile() const {
-   DEBUGF ('r', "returning file_data: " << data);
-   return data;
+base_file_ptr plain_file::clone() const {
+   auto copy = make_pooled<plain_file>();
+   copy->data.reserve (data.size());
+   copy->data.append (data);
+   return copy;
+}
+
+string_view plain_file::readfile() const {
+   string_view file_data = data;
+   DEBUGF ('r', "returning file_data: " << file_data);
+   return file_data;
 }
 
-void plain_file::writefile (const wordvec& words) {
-   this->data = std::move(words);
+void plain_file::writefile (word_range words) {
+   size_t length = 0;
+   for (auto word = words.first; word != words.second; ++word) {
+      if (word != words.first) ++length;
+      length += word->size();
+   }
+   data.clear();
+   data.reserve (length);
+   for (auto word = words.first; word != words.second; ++word) {
+      if (word != words.first) data.append (" ");
+      data.append (*word);
+   }
    DEBUGF ('i', words);
 }
 
+file_buffer::~file_buffer() {
+   if (not is_inline()) delete[] heap_data;
+}
+
+void file_buffer::reserve (size_t wanted) {
+   if (wanted <= capacity) return;
+   size_t grown = max (wanted, capacity * 2);
+   char* bigger = new char[grown];
+   memcpy (bigger, data(), length);
+   if (not is_inline()) delete[] heap_data;
+   heap_data = bigger;
+   capacity = grown;
+}
+
+void file_buffer::append (string_view text) {
+   reserve (length + text.size());
+   memcpy (buffer() + length, text.data(), text.size());
+   length += text.size();
+}
+
 string directory::get_type() {
   return "d";
 }
 
 size_t directory::size() const {
-   size_t size {0};
+   size_t size = dirents.size() + 2;
    DEBUGF ('i', "size = " << size);
    return size;
 }
 
+size_t directory::footprint() const {
+   return sizeof (directory)
+        + dirents.size() * sizeof (dirent_map::value_type);
+}
+
 void directory::remove (const string& filename) {
    DEBUGF ('i', filename);
 } 
 
-inode_ptr directory::mkdir (const string& dirname) {
-   inode_ptr n_dir = make_shared<inode>(file_type::DIRECTORY_TYPE);
+inode_ptr directory::mkdir (string_view dirname) {
+   inode_ptr n_dir = inode::make(file_type::DIRECTORY_TYPE);
    n_dir->set_name(dirname);
    DEBUGF ('i', dirname);
    return n_dir;
 }
 
-inode_ptr directory::mkfile (const string& filename) {
-  inode_ptr file_ptr = make_shared<inode>(file_type::PLAIN_TYPE);
+inode_ptr directory::mkfile (string_view filename) {
+  inode_ptr file_ptr = inode::make(file_type::PLAIN_TYPE);
   file_ptr->set_name(filename);
   DEBUGF('i', filename);
   return file_ptr;
 }
 
-void directory::setup_dir (const inode_ptr& cwd, inode_ptr& parent ) {
-  inode_wk_ptr current_dir = cwd;
-  inode_wk_ptr parent_dir = parent;
-  wk_dirents.insert(pair<string, inode_wk_ptr>("./", current_dir));
-  wk_dirents.insert(pair<string, inode_wk_ptr>("../", parent_dir));
+base_file_ptr directory::clone() const {
+   auto copy = make_pooled<directory>();
+   copy->dirents = dirents;
+   return copy;
 }
 
-map<string,inode_ptr> directory::get_children() {
+const dirent_map& directory::get_children() const {
   return dirents;
 }
 
-map<string,inode_wk_ptr> directory::get_parent() {
-  return wk_dirents;
+inode_ptr directory::find_child (string_view name) const {
+  name_id id;
+  if (not name_table::find(name, id)) return nullptr;
+  const inode_ptr* found = dirents.find(dirent_key(id, false));
+  return found == nullptr ? nullptr : *found;
+}
+
+inode_ptr directory::find_subdir (string_view name) const {
+  name_id id;
+  if (not name_table::find(name, id)) return nullptr;
+  const inode_ptr* found = dirents.find(dirent_key(id, true));
+  return found == nullptr ? nullptr : *found;
+}
+
+void directory::add_child (const inode_ptr& child) {
+  dirents.insert_or_assign(child->key(), child);
+}
+
+void directory::detach_children (vector<inode_ptr>& out) {
+  dirents.drain(out);
 }
 
-void directory::set_children(const map<string,inode_ptr>& child) {
-  dirents = child;
+bool directory::erase_child (string_view name, bool is_dir) {
+  name_id id;
+  if (not name_table::find(name, id)) return false;
+  return dirents.erase(dirent_key(id, is_dir));
 }
@@ -5,95 +5,416 @@
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <atomic>
 #include <exception>
 #include <iostream>
 #include <memory>
 #include <map>
+#include <string_view>
 #include <vector>
 using namespace std;
 
+#include "dirents.h"
+#include "names.h"
 #include "util.h"
 
 // inode_t -
 //    An inode is either a directory or a plain file.
 
-enum class file_type {PLAIN_TYPE, DIRECTORY_TYPE};
+enum class file_type: uint8_t {PLAIN_TYPE, DIRECTORY_TYPE};
 class inode;
 class base_file;
 class plain_file;
 class directory;
-using inode_wk_ptr = weak_ptr<inode>;
-using inode_ptr = shared_ptr<inode>;
+class reclaimer;
+class journal;
+class file_error;
+enum class journal_op: uint8_t;
 using base_file_ptr = shared_ptr<base_file>;
 ostream& operator<< (ostream&, file_type);
 
+// inode_ptr -
+//    Owning reference to an inode.  The count is kept inside the
+//    inode itself, so there is no control block and copying a link
+//    touches only the inode.  The owners of an inode are:  the
+//    dirents of its directory, inode_state's root and cwd, the
+//    reclaimer while a subtree waits to be freed, and short-lived
+//    locals.  Everything else, such as dotdot and the path cache,
+//    is a plain inode* that is only valid while one of those owners
+//    keeps the inode.  The inode is freed when the last owner lets
+//    go.  Any inode* may be turned back into an owning reference.
+//
+//    The count is atomic, because the reclaimer drops the last
+//    references to removed subtrees on its own thread.  Build with
+//    -DYSH_PLAIN_REFCOUNT to make it a plain integer.  That is safe
+//    as things stand:  only a subtree that shares no inode with
+//    anything the shell holds is queued, which inode_state::discard
+//    ensures by freeing on the shell thread while a checkpoint is
+//    saved, and lsr workers read the tree without copying links.
+
+class inode_ptr {
+   private:
+      inode* node {nullptr};
+   public:
+      inode_ptr() = default;
+      inode_ptr (nullptr_t) {}
+      inode_ptr (inode* node_);
+      inode_ptr (const inode_ptr& that);
+      inode_ptr (inode_ptr&& that) noexcept: node (that.node) {
+         that.node = nullptr;
+      }
+      ~inode_ptr();
+      inode_ptr& operator= (inode_ptr that) noexcept {
+         swap (node, that.node);
+         return *this;
+      }
+      inode* get() const { return node; }
+      inode* operator->() const { return node; }
+      inode& operator*() const { return *node; }
+      explicit operator bool() const { return node != nullptr; }
+      size_t use_count() const;
+      bool operator== (const inode_ptr& that) const {
+         return node == that.node;
+      }
+      bool operator!= (const inode_ptr& that) const {
+         return node != that.node;
+      }
+      bool operator== (nullptr_t) const { return node == nullptr; }
+      bool operator!= (nullptr_t) const { return node != nullptr; }
+};
+ostream& operator<< (ostream&, const inode_ptr&);
+
+// dirent_map -
+//    Backing store of a directory.  Flat sorted blocks by default;
+//    build with -DYSH_MAP_DIRENTS to go back to a std::map.
+
+#ifdef YSH_MAP_DIRENTS
+using dirent_map = map_dirents<inode_ptr>;
+#else
+using dirent_map = flat_dirents<inode_ptr>;
+#endif
+
+// dismantle -
+//    Frees a subtree without recursion.  Children are detached onto
+//    an explicit work list, so no destructor ever runs with a
+//    non-empty directory below it and stack use does not depend on
+//    depth.  A node that is still referenced elsewhere (such as cwd)
+//    is left intact along with everything under it.  Returns the
+//    number of inodes freed.
+
+size_t dismantle (inode_ptr subtree);
+
+// path_walk -
+//    Result of resolving a pathname one component at a time.
+//    node is the last directory reached, depth the number of
+//    components consumed.  If a component could not be resolved,
+//    failed names it and node is where the walk stopped.  last is
+//    the final component when the walk was asked to stop before it.
+//    All views point into the pathname that was walked.
+
+struct path_walk {
+   inode_ptr node {nullptr};
+   size_t depth {0};
+   string_view failed {};
+   string_view last {};
+   bool found() const { return failed.empty(); }
+};
+
+// tree_walker -
+//    Visits a directory and every directory below it in preorder,
+//    the order lsr prints them.  State is one cursor per level of
+//    the current path plus the path itself, so memory is O(depth)
+//    whatever the fanout, and nothing is copied out of the tree.
+//    The walk stops wherever the caller stops calling next; the
+//    tree must not change while a walk is in progress.
+// next -
+//    Moves to the next directory, the top one on the first call.
+//    Returns false when the walk is over.
+// skip -
+//    Don't descend below the current directory.
+// dir, path, depth -
+//    The current directory, its path as lsr shows it (children are
+//    the parent's path, a slash and their name), and its depth
+//    below the top.
+
+class tree_walker {
+   private:
+      struct cursor {
+         dirent_map::const_iterator next;
+         dirent_map::const_iterator end;
+         size_t prefix;
+      };
+      vector<cursor> stack;
+      inode_ptr current;
+      string path_;
+      bool started {false};
+      bool descend {true};
+   public:
+      tree_walker (const inode_ptr& top, const string& path);
+      bool next();
+      void skip() { descend = false; }
+      const inode_ptr& dir() const { return current; }
+      const string& path() const { return path_; }
+      size_t depth() const { return stack.size(); }
+};
+
 
+// path_cache -
+//    Bounded cache of resolved directory paths, keyed by the inode
+//    number of the directory the walk started from plus the path
+//    relative to it.  Only successful walks are stored, so creating
+//    a directory can never make an entry stale.  Removing a
+//    directory must clear the cache, and that is also what keeps
+//    the plain inode pointers in it valid.  Moving cwd needs no
+//    invalidation because the key names the starting directory
+//    rather than cwd.
+
+class path_cache {
+   private:
+      struct entry {
+         size_t dir_nr {0};
+         string path {};
+         inode* node {nullptr};
+         size_t depth {0};
+      };
+      vector<entry> slots;
+      size_t used {0};
+      size_t hits_ {0};
+      size_t misses_ {0};
+      entry& slot_for (size_t dir_nr, string_view path);
+   public:
+      explicit path_cache (size_t capacity = 4096);
+      inode_ptr find (size_t dir_nr, string_view path, size_t& depth);
+      void insert (size_t dir_nr, string_view path,
+                   const inode_ptr& node, size_t depth);
+      void clear();
+      size_t hits() const { return hits_; }
+      size_t misses() const { return misses_; }
+      size_t size() const { return used; }
+};
+
 // inode_state -
 //    A small convenient class to maintain the state of the simulated
 //    process:  the root (/), the current directory (.), and the
 //    prompt.
+// open_journal -
+//    Loads base.snap if there is one, replays base.jnl on top of it,
+//    and from then on logs every change to the tree there.  Every
+//    so often the tree is checkpointed into base.snap.  While the
+//    working directory is one that has been removed, checkpoints
+//    wait, since its path could not be replayed.  If a record fails
+//    to replay, throws file_error and runs without a journal, with
+//    the tree as replayed up to that record.
+// checkpoint, rollback -
+//    checkpoint saves the tree and cwd as a version in O(1):  it
+//    only keeps a reference to the root and starts a new epoch.
+//    Every inode older than the newest version is then frozen, and
+//    is copied before it is changed, along with the directories
+//    above it, so only the modified paths are copied and the rest
+//    is shared.  rollback puts back the newest version and drops
+//    it.  Versions nest.  load and mount throw file_error while a
+//    version is saved:  they are not journaled but replace the
+//    tree by checkpointing the journal, which must wait until no
+//    version is saved, so a restart could not replay them.
+// writable -
+//    The inode to change in place of node:  node itself if it is
+//    not frozen, otherwise a copy linked into the tree where it
+//    was.  The copy takes over node's children, and any of them
+//    that are frozen have their dotdot change logged so rollback
+//    can put it back.
 
 class inode_state {
    friend class inode;
    friend ostream& operator<< (ostream& out, const inode_state&);
    private:
+      struct version {
+         inode_ptr root;
+         inode_ptr cwd;
+         uint32_t epoch;
+         vector<pair<inode*,inode*>> dotdots;
+      };
       inode_ptr root {nullptr};
       inode_ptr cwd {nullptr};
       string prompt_ {"% "};
       int errors {0};
+      path_cache cache;
+      unique_ptr<reclaimer> reclaim;
+      size_t lsr_jobs {1};
+      string cwd_path;
+      unique_ptr<journal> log;
+      string journal_base;
+      wordvec log_words;
+      vector<version> versions;
+      void refuse_with_versions() const;
+      void detach_cwd(const inode_ptr& dir);
+      void leave_cwd(inode_ptr old_cwd);
+      void discard(inode_ptr subtree);
+      bool frozen(const inode* node) const;
+      void set_dotdot(inode* node, inode* dotdot);
+      inode_ptr writable(const inode_ptr& node);
+      void replace_tree(inode_ptr top);
+      void journal_change(journal_op op, string_view path);
+      void journal_change(journal_op op, word_range words);
+      void replay_change(journal_op op, const wordvec& words);
+      void write_snapshot(const string& filename, uint64_t journal_seq);
+      void compact_journal();
+      void close_journal(const file_error& error);
    public:
       inode_state (const inode_state&) = delete; // copy ctor
       inode_state& operator= (const inode_state&) = delete; // op=
       inode_state();
+      ~inode_state();
       const string& prompt() const;
       void prompt (const string&);
-      void make_directory(const wordvec& dirname);
+      void make_directory(string_view dirname);
       void make_file(const wordvec& words);
       void print_file(const wordvec& words);
-      inode_ptr directory_search(const wordvec& input, 
-      inode_ptr curr, bool make);
-      void change_directory(const wordvec& dirname);
-      void list(const wordvec& path);
-      void listr(const wordvec& path);
-      void print_recursive(inode_ptr curr, wordvec path);
+      path_walk walk(string_view pathname, inode_ptr curr, bool make);
+      inode_ptr directory_search(string_view pathname,
+                                 inode_ptr curr, bool make);
+      void change_directory(string_view dirname);
+      void list(string_view pathname);
+      void listr(string_view pathname);
+      void set_lsr_jobs(size_t jobs);
+      const string& working_directory();
       void print_working_directory();
-      void rmr(const wordvec& words);
-      void remove_here(const wordvec& path);
+      void rmr(string_view pathname);
+      void remove_here(string_view pathname);
       void set_prompt(const wordvec& words);
       int get_errors();
+      void print_cache_stats();
+      void sync();
+      void print_reclaim_stats();
+      void save(string_view filename);
+      void load(string_view filename);
+      void mount(string_view filename);
+      void open_journal(const string& base);
+      void print_journal_stats();
+      void checkpoint();
+      void rollback();
 };
 
 // class inode -
-// inode ctor -
-//    Create a new inode of the given type.
+// make -
+//    Create a new inode of the given type in the slab pool.  Inodes
+//    are only ever created this way, and only freed by inode_ptr.
+//    Given an inode number, the inode takes it instead of the next
+//    in sequence, and later inodes are numbered above it; a tree
+//    loaded from a snapshot keeps its numbers this way.  Given
+//    contents, which must suit the type, the inode holds them
+//    instead of empty ones.
+// clone -
+//    A new inode with the same number and name and a copy of the
+//    contents.  A directory's copy shares its children.
 // get_inode_nr -
 //    Retrieves the serial number of the inode.  Inode numbers are
 //    allocated in sequence by small integer.
+// live -
+//    Number of inodes currently allocated.
+// footprint -
+//    Approximate bytes owned by this inode alone, not counting
+//    anything below it.
 // size -
 //    Returns the size of an inode.  For a directory, this is the
-//    number of dirents.  For a text file, the number of characters
-//    when printed (the sum of the lengths of each word, plus the
-//    number of words.
-//    
+//    number of dirents, counting dot and dotdot.  For a text file,
+//    the number of characters when printed (the sum of the lengths
+//    of each word, plus the number of words.
+// set_name -
+//    Names the inode, by text or by an already interned handle.
+// key -
+//    The inode's name as it appears in its parent's dirents.  The
+//    name is interned; the inode holds only the handle.
+// read, write -
+//    The contents of a plain file.  Throw file_error for a
+//    directory.
+// get_lower -
+//    Read-only view of the children of a directory.  No copy is
+//    made; the reference is valid until the directory is next
+//    modified.
+// get_parent, set_parent -
+//    The directory holding the inode, which for a directory is its
+//    dotdot entry, held directly on the inode as a plain pointer:
+//    a directory owns its children, so the parent outlives them.
+//    The root is its own parent.  A child that is detached from its
+//    directory loses its dotdot, and get_parent then returns
+//    nullptr; cwd is detached this way when its directory is
+//    removed.  A child still shared with a saved version keeps its
+//    dotdot.  Dot is the inode itself and is not stored at all.
+// find_lower, add_lower, erase_lower -
+//    Look up, insert or remove a single dirent in place.
+//    find_lower returns nullptr if there is no such entry.
+//    find_lower_dir looks up a subdirectory by its bare name.
+//    add_lower files the child under its own key.
 
 class inode {
    friend class inode_state;
    private:
       static size_t next_inode_nr;
+      static uint32_t current_epoch;
+      static atomic<size_t> live_inodes;
+      friend class inode_ptr;
+#ifdef YSH_PLAIN_REFCOUNT
+      using ref_count = uint32_t;
+#else
+      using ref_count = atomic<uint32_t>;
+#endif
       size_t inode_nr;
+      name_id name {0};
+      mutable ref_count refs {0};
+      file_type ftype;
+      bool named {false};
+      uint32_t epoch;
+      inode* parent {nullptr};
       base_file_ptr contents;
-      string name {""};
+      static void destroy (inode* node);
    public:
       inode (file_type);
+      inode (file_type, size_t nr, base_file_ptr data = nullptr);
+      static inode_ptr make (file_type type);
+      static inode_ptr make (file_type type, size_t nr,
+                             base_file_ptr data = nullptr);
+      inode_ptr clone() const;
+      ~inode();
+      inode (const inode&) = delete;
+      inode& operator= (const inode&) = delete;
       size_t get_inode_nr() const;
-      void set_name(string);
-      map<string, inode_wk_ptr>get_higher();
-      map<string, inode_ptr>get_lower();
-      void set_lower(const map<string, inode_ptr>& child);
+      static size_t live() { return live_inodes; }
+      size_t footprint() const;
+      size_t size() const;
+      void set_name(string_view input);
+      void set_name(name_id id);
+      dirent_key key() const;
+      string_view read() const;
+      void write(word_range words);
+      const dirent_map& get_lower() const;
+      inode* get_parent() const { return parent; }
+      void set_parent(inode* dotdot) { parent = dotdot; }
+      inode_ptr find_lower(string_view dirent) const;
+      inode_ptr find_lower_dir(string_view dirname) const;
+      void add_lower(const inode_ptr& child);
+      bool erase_lower(string_view dirent, bool is_dir);
+      void detach_lower(vector<inode_ptr>& out);
       string type();
 
 };
 
+inline inode_ptr::inode_ptr (inode* node_): node (node_) {
+   if (node != nullptr) ++node->refs;
+}
+
+inline inode_ptr::inode_ptr (const inode_ptr& that): node (that.node) {
+   if (node != nullptr) ++node->refs;
+}
+
+inline inode_ptr::~inode_ptr() {
+   if (node != nullptr and --node->refs == 0) inode::destroy (node);
+}
+
+inline size_t inode_ptr::use_count() const {
+   if (node == nullptr) return 0;
+   return node->refs;
+}
+
 
 // class base_file -
 // Just a base class at which an inode can point.  No data or
@@ -114,42 +435,87 @@ class base_file {
       base_file (const base_file&) = delete;
       base_file& operator= (const base_file&) = delete;
       virtual size_t size() const = 0;
-      virtual const wordvec& readfile() const;
-      virtual void writefile (const wordvec& newdata);
+      virtual size_t footprint() const = 0;
+      virtual base_file_ptr clone() const;
+      virtual string_view readfile() const;
+      virtual void writefile (word_range newdata);
       virtual void remove (const string& filename);
-      virtual inode_ptr mkdir (const string& dirname);
-      virtual inode_ptr mkfile (const string& words);
-      virtual void setup_dir(const inode_ptr& cwd, inode_ptr& parent);
-      virtual map<string,inode_ptr> get_children();
-      virtual map<string,inode_wk_ptr> get_parent();
-      virtual void set_children(const map<string,inode_ptr>& child);
+      virtual inode_ptr mkdir (string_view dirname);
+      virtual inode_ptr mkfile (string_view filename);
+      virtual const dirent_map& get_children() const;
+      virtual inode_ptr find_child (string_view name) const;
+      virtual inode_ptr find_subdir (string_view name) const;
+      virtual void add_child (const inode_ptr& child);
+      virtual bool erase_child (string_view name, bool is_dir);
+      virtual void detach_children (vector<inode_ptr>& out);
       virtual string get_type();
 };
 
+// class file_buffer -
+// Contents of a plain file.  Up to INLINE_CAPACITY bytes are held
+// inside the object itself, so a small file costs no heap block
+// beyond its plain_file.  Larger contents spill to the heap.
+// reserve -
+//    Makes room for at least the given length.  Contents are kept.
+// heap_bytes -
+//    Bytes allocated outside the object, zero while inline.
+
+class file_buffer {
+   public:
+      static constexpr size_t INLINE_CAPACITY {48};
+   private:
+      size_t length {0};
+      size_t capacity {INLINE_CAPACITY};
+      union {
+         char inline_data[INLINE_CAPACITY];
+         char* heap_data;
+      };
+      bool is_inline() const { return capacity == INLINE_CAPACITY; }
+      char* buffer() { return is_inline() ? inline_data : heap_data; }
+   public:
+      file_buffer() {}
+      ~file_buffer();
+      file_buffer (const file_buffer&) = delete;
+      file_buffer& operator= (const file_buffer&) = delete;
+      const char* data() const {
+         return is_inline() ? inline_data : heap_data;
+      }
+      size_t size() const { return length; }
+      size_t heap_bytes() const { return is_inline() ? 0 : capacity; }
+      void clear() { length = 0; }
+      void reserve (size_t wanted);
+      void append (string_view text);
+      operator string_view() const { return {data(), length}; }
+};
+
 // class plain_file -
-// Used to hold data.
+// Used to hold data.  The words are kept in one buffer, separated
+// by single spaces, so the buffer length is also the file size.
 // synthesized default ctor -
-//    Default vector<string> is a an empty vector.
+//    Default file_buffer is empty.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns a view of the contents, valid until the next write.
 // writefile -
-//    Replaces the contents of a file with new contents.
+//    Replaces the contents of a file with new contents, sizing the
+//    buffer once for all of the words.
+// clone -
+//    A new plain_file holding a copy of the buffer.
 
 class plain_file: public base_file {
    private:
-      wordvec data;
+      file_buffer data;
       virtual const string& error_file_type() const override {
          static const string result = "plain file";
          return result;
       }
    public:
       virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
-      virtual inode_ptr mkfile (const string& filename) override;
+      virtual size_t footprint() const override;
+      virtual base_file_ptr clone() const override;
+      virtual string_view readfile() const override;
+      virtual void writefile (word_range newdata) override;
+      virtual inode_ptr mkfile (string_view filename) override;
       virtual string get_type() override;
-      //virtual map<string,inode_ptr> get_children() override;
-      //virtual map<string,inode_wk_ptr> get_parent() override;
 };
 
 // class directory -
@@ -169,28 +535,44 @@ class plain_file: public base_file {
 // mkfile -
 //    Create a new empty text file with the given name.  Error if
 //    a dirent with that name exists.
+// find_child, find_subdir, add_child, erase_child -
+//    Operate on one dirent without copying the rest of the map.
+//    Names that were never interned cannot be in any directory,
+//    so they are rejected before the map is searched.
+//    add_child replaces any existing entry of the same name, and
+//    erase_child returns false if there was nothing to remove.
+// detach_children -
+//    Moves every child out onto a list and leaves the directory
+//    empty.  A plain file has no children, so for it this does
+//    nothing rather than throw.
+// clone -
+//    A new directory with a copy of the dirents, pointing at the
+//    same children.
 
 class directory: public base_file {
    private:
-      // Must be a map, not unordered_map, so printing is lexicographic
-      //size_t dir_size;
-      map<string,inode_ptr> dirents;
-      map<string,inode_wk_ptr> wk_dirents;
+      // Must be ordered, not hashed, so printing is lexicographic
+      dirent_map dirents;
       virtual const string& error_file_type() const override {
          static const string result = "directory";
          return result;
       }
    public:
       virtual size_t size() const override;
+      virtual size_t footprint() const override;
+      virtual base_file_ptr clone() const override;
       virtual void remove (const string& filename) override;
-      virtual inode_ptr mkdir (const string& dirname) override;
-      virtual inode_ptr mkfile (const string& filename) override;
-      virtual void setup_dir (const inode_ptr& cwd, 
-      inode_ptr& parent) override;
-      virtual map<string,inode_ptr> get_children() override;
-      virtual map<string,inode_wk_ptr> get_parent() override;
-      virtual void set_children(
-      const map<string,inode_ptr>& child) override;
+      virtual inode_ptr mkdir (string_view dirname) override;
+      virtual inode_ptr mkfile (string_view filename) override;
+      virtual const dirent_map& get_children() const override;
+      virtual inode_ptr find_child (string_view name)
+      const override;
+      virtual inode_ptr find_subdir (string_view name)
+      const override;
+      virtual void add_child (const inode_ptr& child) override;
+      virtual bool erase_child (string_view name, bool is_dir)
+      override;
+      virtual void detach_children (vector<inode_ptr>& out) override;
       virtual string get_type() override;
 };
 
@@ -0,0 +1,310 @@
+// $Id: journal.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "file_sys.h"
+#include "journal.h"
+#include "output.h"
+
+namespace {
+
+constexpr char MAGIC[8] {'Y','S','H','J','R','N','L','\0'};
+constexpr uint32_t VERSION {1};
+constexpr size_t HEADER_SIZE {16};
+constexpr size_t RECORD_PREFIX {8};
+
+file_error journal_error (const string& filename, const string& why) {
+   return file_error (filename + ": " + why);
+}
+
+uint32_t checksum (string_view bytes) {
+   uint32_t hash = 2166136261u;
+   for (char byte: bytes) {
+      hash = (hash ^ static_cast<uint8_t> (byte)) * 16777619u;
+   }
+   return hash;
+}
+
+template <typename item_t>
+void put (string& out, item_t item) {
+   out.append (reinterpret_cast<const char*> (&item), sizeof item);
+}
+
+template <typename item_t>
+item_t get (const char* in) {
+   item_t item;
+   memcpy (&item, in, sizeof item);
+   return item;
+}
+
+void put_varint (string& out, uint64_t value) {
+   while (value >= 0x80) {
+      out.push_back (static_cast<char> (value | 0x80));
+      value >>= 7;
+   }
+   out.push_back (static_cast<char> (value));
+}
+
+// get_varint -
+//    Reads a varint from in, advancing it.  False if it runs past
+//    the end or is too long.
+
+bool get_varint (string_view& in, uint64_t& value) {
+   value = 0;
+   for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (in.empty()) return false;
+      uint8_t byte = static_cast<uint8_t> (in.front());
+      in.remove_prefix (1);
+      value |= uint64_t (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+   }
+   return false;
+}
+
+}
+
+journal::journal (const string& filename_, uint64_t after,
+                  const apply_fn& apply):
+         filename (filename_), appended (after), durable (after) {
+   replay (after, apply);
+   worker = thread (&journal::run, this);
+}
+
+journal::~journal() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   wakeup.notify_one();
+   worker.join();
+   if (fd >= 0) close (fd);
+}
+
+// journal::replay -
+//    Reads the whole file, applies the records past after, and
+//    leaves fd open at the end of the last good record.  A missing
+//    or empty file is created.  Only changes that succeeded are
+//    logged, so a record that fails to apply means the tree no
+//    longer matches the one that wrote it; replay stops there and
+//    the file is left as it is.
+
+void journal::replay (uint64_t after, const apply_fn& apply) {
+   fd = open (filename.c_str(), O_RDWR);
+   if (fd < 0 and errno == ENOENT) {
+      create (filename);
+      return;
+   }
+   if (fd < 0) throw journal_error (filename, strerror (errno));
+   string text;
+   char block[1 << 16];
+   for (;;) {
+      ssize_t got = read (fd, block, sizeof block);
+      if (got == 0) break;
+      if (got < 0) {
+         if (errno == EINTR) continue;
+         throw journal_error (filename, strerror (errno));
+      }
+      text.append (block, static_cast<size_t> (got));
+   }
+   if (text.empty()) {
+      close (fd);
+      create (filename);
+      return;
+   }
+   if (text.size() < HEADER_SIZE
+       or memcmp (text.data(), MAGIC, sizeof MAGIC) != 0
+       or get<uint32_t> (text.data() + sizeof MAGIC) != VERSION) {
+      close (fd);
+      fd = -1;
+      throw journal_error (filename, "not a journal");
+   }
+
+   size_t good = HEADER_SIZE;
+   size_t replayed = 0;
+   wordvec words;
+   while (text.size() - good >= RECORD_PREFIX) {
+      uint32_t size = get<uint32_t> (text.data() + good);
+      uint32_t sum = get<uint32_t> (text.data() + good + 4);
+      if (size > text.size() - good - RECORD_PREFIX) break;
+      string_view body (text.data() + good + RECORD_PREFIX, size);
+      if (checksum (body) != sum or body.size() < 9) break;
+      uint64_t seq = get<uint64_t> (body.data());
+      auto op = static_cast<journal_op> (body[8]);
+      body.remove_prefix (9);
+      words.clear();
+      uint64_t length = 0;
+      bool whole = true;
+      while (not body.empty()) {
+         if (not get_varint (body, length) or length > body.size()) {
+            whole = false;
+            break;
+         }
+         words.push_back (body.substr (0, length));
+         body.remove_prefix (length);
+      }
+      if (not whole or op > journal_op::ROLLBACK) break;
+      good += RECORD_PREFIX + size;
+      if (seq <= after) continue;
+      try {
+         apply (op, words);
+      }catch (file_error& error) {
+         close (fd);
+         fd = -1;
+         throw journal_error (filename, "record " + to_string (seq)
+                              + ": " + error.what());
+      }
+      appended = durable = seq;
+      ++logged_records;
+      logged_bytes += RECORD_PREFIX + size;
+      ++replayed;
+   }
+   if (good < text.size()) {
+      DEBUGF ('j', filename << ": dropping " << text.size() - good
+              << " bytes of torn tail");
+      if (ftruncate (fd, static_cast<off_t> (good)) != 0) {
+         throw journal_error (filename, strerror (errno));
+      }
+   }
+   lseek (fd, static_cast<off_t> (good), SEEK_SET);
+   DEBUGF ('j', filename << ": replayed " << replayed
+           << " records, last " << appended);
+}
+
+// journal::create -
+//    Writes an empty journal to a temporary file, makes it durable
+//    and renames it to filename, so a crash leaves either the old
+//    journal or the new one.  fd is left open on the new file.
+
+void journal::create (const string& path) {
+   string temp = path + ".tmp";
+   int temp_fd = open (temp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+   if (temp_fd < 0) throw journal_error (temp, strerror (errno));
+   string header (MAGIC, sizeof MAGIC);
+   put (header, VERSION);
+   header.resize (HEADER_SIZE);
+   if (not write_all (temp_fd, header.data(), header.size())
+       or fdatasync (temp_fd) != 0
+       or rename (temp.c_str(), path.c_str()) != 0) {
+      int saved = errno;
+      close (temp_fd);
+      unlink (temp.c_str());
+      throw journal_error (path, strerror (saved));
+   }
+   fd = temp_fd;
+}
+
+void journal::append (journal_op op, word_range words) {
+   size_t start;
+   {
+      lock_guard<mutex> guard (lock);
+      if (not failure.empty()) throw journal_error (filename, failure);
+      start = pending.size();
+      put (pending, uint32_t (0));
+      put (pending, uint32_t (0));
+      put (pending, ++appended);
+      pending.push_back (static_cast<char> (op));
+      for (auto word = words.first; word != words.second; ++word) {
+         put_varint (pending, word->size());
+         pending.append (word->data(), word->size());
+      }
+      auto size = static_cast<uint32_t>
+                  (pending.size() - start - RECORD_PREFIX);
+      uint32_t sum = checksum (string_view (pending).substr
+                               (start + RECORD_PREFIX));
+      memcpy (&pending[start], &size, sizeof size);
+      memcpy (&pending[start + 4], &sum, sizeof sum);
+      ++logged_records;
+      logged_bytes += RECORD_PREFIX + size;
+      if (start > 0 and pending.size() < GROUP_BYTES) return;
+   }
+   wakeup.notify_one();
+}
+
+void journal::sync() {
+   unique_lock<mutex> guard (lock);
+   ++syncing;
+   wakeup.notify_one();
+   committed.wait (guard, [this] {
+      return (durable == appended and not busy)
+             or not failure.empty();
+   });
+   --syncing;
+   if (not failure.empty()) throw journal_error (filename, failure);
+}
+
+bool journal::due() const {
+   return logged_records >= CHECKPOINT_RECORDS
+       or logged_bytes >= CHECKPOINT_BYTES;
+}
+
+void journal::restart() {
+   sync();
+   lock_guard<mutex> guard (lock);
+   int old_fd = fd;
+   create (filename);
+   close (old_fd);
+   logged_records = 0;
+   logged_bytes = 0;
+}
+
+void journal::report (ostream& out) {
+   lock_guard<mutex> guard (lock);
+   out << "journal: " << appended << " records, " << durable
+       << " durable, " << groups << " groups committed\n";
+}
+
+// journal::run -
+//    Group commit.  Waits up to COMMIT_INTERVAL for records to
+//    gather, or less if enough are waiting or sync is waiting,
+//    then writes everything pending with one write and one
+//    fdatasync.  Appends carry on into a fresh buffer meanwhile.
+//    After a failed commit the file ends in an unknown state, so
+//    nothing more is written; what is pending is dropped.
+
+void journal::run() {
+   unique_lock<mutex> guard (lock);
+   string group;
+   for (;;) {
+      wakeup.wait (guard, [this] {
+         return stopping or not pending.empty();
+      });
+      if (pending.empty()) break;
+      if (not failure.empty()) {
+         pending.clear();
+         continue;
+      }
+      if (not stopping and pending.size() < GROUP_BYTES) {
+         wakeup.wait_for (guard, COMMIT_INTERVAL, [this] {
+            return stopping or syncing > 0
+                or pending.size() >= GROUP_BYTES;
+         });
+      }
+      group.clear();
+      swap (group, pending);
+      uint64_t last = appended;
+      busy = true;
+      guard.unlock();
+      bool good = write_all (fd, group.data(), group.size())
+              and fdatasync (fd) == 0;
+      int saved = errno;
+      guard.lock();
+      busy = false;
+      if (good) {
+         durable = last;
+         ++groups;
+      }else {
+         failure = strerror (saved);
+         DEBUGF ('j', filename << ": commit failed: " << failure);
+      }
+      committed.notify_all();
+   }
+}
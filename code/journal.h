@@ -0,0 +1,117 @@
+// $Id: journal.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// journal -
+//    Write-ahead log of the commands that change the tree, for
+//    yshell -J.  Each change is appended as one binary record after
+//    it succeeds.  A commit thread writes the records out in groups
+//    and makes each group durable with one fdatasync, so a make
+//    costs an append to a memory buffer, not a disk write.  Every
+//    so often the tree is checkpointed into a snapshot and the
+//    journal started afresh, so a restart loads the snapshot and
+//    replays only the records since.
+//
+//    The file is a 16-byte header, magic and version, followed by
+//    records:
+//       uint32  size of the rest of the record
+//       uint32  FNV-1a checksum of the rest of the record
+//       uint64  sequence number, counting up across checkpoints
+//       uint8   journal_op
+//       words   each a varint length and the bytes
+//    A torn or damaged record ends the journal; it and anything
+//    after it are dropped when the journal is opened.
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+using namespace std;
+
+#include "util.h"
+
+// journal_op -
+//    The logged commands.  MAKE's words are the pathname and then
+//    the data; CD's are empty for a cd to the root.  CHECKPOINT and
+//    ROLLBACK have no words.
+
+enum class journal_op: uint8_t {MKDIR, MAKE, RM, RMR, CD,
+                                CHECKPOINT, ROLLBACK};
+
+// journal -
+// ctor -
+//    Opens or creates the journal file.  Every record whose sequence
+//    number is above after is passed to apply, in order; then the
+//    file is cut back to its last good record and opened for
+//    appending.  Throws file_error if it cannot be read or written,
+//    or if a record fails to apply, in which case the records
+//    before it have been applied and the file is not touched.
+// dtor -
+//    Commits anything pending and joins the thread.
+// append -
+//    Queues a record.  The commit thread writes it within
+//    COMMIT_INTERVAL, or at once if GROUP_BYTES are waiting.  Throws
+//    file_error if an earlier commit failed.
+// sync -
+//    Waits until every record appended so far is durable.  Throws
+//    file_error if a commit failed.
+//    A failure is final:  every later append and sync throws it
+//    again at once, and nothing more is written.
+// due -
+//    Whether enough has been logged since the last checkpoint that
+//    it is time for another.
+// restart -
+//    After a checkpoint:  syncs, then replaces the file with an
+//    empty journal.  Sequence numbers carry on.
+// sequence -
+//    The sequence number of the last record appended.
+// report -
+//    Prints the record, group and sync counts.
+
+class journal {
+   public:
+      using apply_fn = function<void (journal_op, const wordvec&)>;
+      static constexpr size_t GROUP_BYTES {256 * 1024};
+      static constexpr chrono::milliseconds COMMIT_INTERVAL {5};
+      static constexpr uint64_t CHECKPOINT_RECORDS {1 << 18};
+      static constexpr uint64_t CHECKPOINT_BYTES {64 << 20};
+   private:
+      string filename;
+      int fd {-1};
+      mutex lock;
+      condition_variable wakeup;
+      condition_variable committed;
+      string pending;
+      uint64_t appended {0};
+      uint64_t durable {0};
+      uint64_t logged_records {0};
+      uint64_t logged_bytes {0};
+      size_t groups {0};
+      size_t syncing {0};
+      bool busy {false};
+      bool stopping {false};
+      string failure;
+      thread worker;
+      void replay (uint64_t after, const apply_fn& apply);
+      void create (const string& path);
+      void run();
+   public:
+      journal (const string& filename_, uint64_t after,
+               const apply_fn& apply);
+      ~journal();
+      journal (const journal&) = delete;
+      journal& operator= (const journal&) = delete;
+      void append (journal_op op, word_range words);
+      void sync();
+      bool due() const;
+      void restart();
+      uint64_t sequence() const { return appended; }
+      void report (ostream& out);
+};
+
+#endif
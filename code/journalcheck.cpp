@@ -0,0 +1,115 @@
+// $Id: journalcheck.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// journalcheck -
+//    Runs a session under a journal, as yshell -J does, mixing
+//    changes with a load, checkpoints, a rollback, and a load and a
+//    mount refused while a checkpoint is saved.  Then starts a new
+//    session on the same journal and checks that it comes back with
+//    the same tree and cwd, and that its replayed checkpoint rolls
+//    back to the loaded tree.  Inode numbers are left out of the
+//    comparison, since a second session in one process numbers its
+//    inodes afresh.  Works in a temporary directory it removes.
+//    Usage:  journalcheck
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+#include "file_sys.h"
+
+// describe -
+//    The cwd and the lsr of the whole tree, without inode numbers.
+
+string describe (inode_state& state) {
+   ostringstream listing;
+   streambuf* saved = cout.rdbuf (listing.rdbuf());
+   state.listr ("/");
+   cout.rdbuf (saved);
+   string result = state.working_directory();
+   istringstream lines (listing.str());
+   string line;
+   while (getline (lines, line)) {
+      size_t number = line.find_first_not_of (' ');
+      size_t after = line.find (' ', number);
+      bool entry = number != string::npos and after != string::npos
+                   and isdigit (line[number]);
+      result.append (entry ? line.substr (after) : line).append ("\n");
+   }
+   return result;
+}
+
+bool refused (void (inode_state::*replace) (string_view),
+              inode_state& state, const string& filename) {
+   try {
+      (state.*replace) (filename);
+   }catch (file_error&) {
+      return true;
+   }
+   return false;
+}
+
+bool check (bool good, const char* what) {
+   if (not good) cerr << "journalcheck: " << what << endl;
+   return good;
+}
+
+int main (int, char**) {
+   char dir_template[] = "/tmp/journalcheckXXXXXX";
+   if (mkdtemp (dir_template) == nullptr) {
+      cerr << "journalcheck: cannot make a temporary directory"
+           << endl;
+      return EXIT_FAILURE;
+   }
+   string dir = dir_template;
+   string base = dir + "/j";
+   string saved = dir + "/saved.snap";
+   bool good = true;
+   string before;
+   {
+      inode_state state;
+      state.open_journal (base);
+      state.make_directory ("a");
+      state.make_file ({"make", "a/f", "one"});
+      state.save (saved);
+      state.make_directory ("c");
+      state.load (saved);
+      state.checkpoint();
+      state.make_directory ("b");
+      state.make_file ({"make", "b/g", "two"});
+      good &= check (refused (&inode_state::load, state, saved),
+                     "load allowed with a checkpoint saved");
+      good &= check (refused (&inode_state::mount, state, saved),
+                     "mount allowed with a checkpoint saved");
+      state.checkpoint();
+      state.rmr ("a");
+      state.rollback();
+      state.change_directory ("b");
+      state.make_file ({"make", "h", "three"});
+      state.sync();
+      before = describe (state);
+   }
+   {
+      inode_state state;
+      state.open_journal (base);
+      good &= check (describe (state) == before,
+                     "restart gave a different tree");
+      state.rollback();
+      string after = describe (state);
+      inode_state loaded;
+      loaded.load (saved);
+      good &= check (after == describe (loaded),
+                     "rollback after restart gave a different tree");
+   }
+   for (const char* name: {"/j.snap", "/j.jnl", "/saved.snap"}) {
+      unlink ((dir + name).c_str());
+   }
+   rmdir (dir.c_str());
+   cout << "journalcheck: " << (good ? "ok" : "FAILED") << endl;
+   return good ? EXIT_SUCCESS : EXIT_FAILURE;
+}
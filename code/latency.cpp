@@ -0,0 +1,56 @@
+// $Id: latency.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+#include "latency.h"
+
+namespace {
+
+constexpr uint64_t HALF_COUNT {latency_histogram::SUB_COUNT / 2};
+
+}
+
+// latency_histogram::index_of -
+//    A value below SUB_COUNT is its own index.  Above, shift is how
+//    far the value must move right to leave SUB_BITS bits, and
+//    those bits, which start with a 1, pick the bucket within that
+//    power of two.
+
+size_t latency_histogram::index_of (uint64_t value) {
+   if (value < SUB_COUNT) return value;
+   unsigned magnitude = 63 - __builtin_clzll (value);
+   unsigned shift = magnitude - (SUB_BITS - 1);
+   return shift * HALF_COUNT + (value >> shift);
+}
+
+uint64_t latency_histogram::highest_in (size_t index) {
+   if (index < SUB_COUNT) return index;
+   unsigned shift = index / HALF_COUNT - 1;
+   uint64_t top = index % HALF_COUNT + HALF_COUNT;
+   return ((top + 1) << shift) - 1;
+}
+
+void latency_histogram::record (uint64_t value) {
+   value = min (value, MAX_VALUE);
+   if (buckets.empty()) buckets.resize (index_of (MAX_VALUE) + 1);
+   ++buckets[index_of (value)];
+   ++count_;
+   total_ += value;
+   max_ = std::max (max_, value);
+}
+
+uint64_t latency_histogram::percentile (double fraction) const {
+   if (count_ == 0) return 0;
+   auto rank = static_cast<uint64_t> (ceil (fraction * count_));
+   rank = clamp<uint64_t> (rank, 1, count_);
+   uint64_t seen = 0;
+   for (size_t index = 0; index < buckets.size(); ++index) {
+      seen += buckets[index];
+      if (seen >= rank) return min (highest_in (index), max_);
+   }
+   return max_;
+}
@@ -0,0 +1,85 @@
+// $Id: latency.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// latency -
+//    Histograms of how long something took, in nanoseconds, read
+//    off steady_clock.  Buckets are log-linear, as in HdrHistogram:
+//    below SUB_COUNT every value has its own bucket, and above it
+//    each power of two is split into SUB_COUNT / 2 buckets, so a
+//    value is recorded to within 1 part in 64 at any magnitude.
+//    Recording is an index computation and an increment; the
+//    buckets are allocated at the first value.
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// latency_histogram -
+// record -
+//    Counts one value.  Values past MAX_VALUE count as MAX_VALUE.
+// count, total, max -
+//    The number of values, their sum and the largest.
+// percentile -
+//    The value at or below which fraction of the values fall, as the
+//    highest value its bucket can hold but no more than max.  Zero
+//    if nothing has been recorded.
+
+class latency_histogram {
+   public:
+      static constexpr unsigned SUB_BITS {7};
+      static constexpr uint64_t SUB_COUNT {uint64_t (1) << SUB_BITS};
+      static constexpr uint64_t MAX_VALUE {(uint64_t (1) << 40) - 1};
+   private:
+      vector<uint64_t> buckets;
+      uint64_t count_ {0};
+      uint64_t total_ {0};
+      uint64_t max_ {0};
+      static size_t index_of (uint64_t value);
+      static uint64_t highest_in (size_t index);
+   public:
+      void record (uint64_t value);
+      uint64_t count() const { return count_; }
+      uint64_t total() const { return total_; }
+      uint64_t max() const { return max_; }
+      uint64_t percentile (double fraction) const;
+};
+
+// latency_lap -
+//    A running clock for timing things back to back.  record charges
+//    the time since the last record, or since the lap was started or
+//    restarted, so a run of commands costs one clock read apiece.
+// latency_timer -
+//    Records a lap into a histogram when it goes out of scope, so a
+//    command that leaves by throwing is counted too.
+
+class latency_lap {
+   private:
+      chrono::steady_clock::time_point last;
+   public:
+      latency_lap(): last (chrono::steady_clock::now()) {}
+      void restart() { last = chrono::steady_clock::now(); }
+      void record (latency_histogram& into) {
+         auto now = chrono::steady_clock::now();
+         into.record (chrono::duration_cast<chrono::nanoseconds>
+                      (now - last).count());
+         last = now;
+      }
+};
+
+class latency_timer {
+   private:
+      latency_lap& lap;
+      latency_histogram& into;
+   public:
+      latency_timer (latency_lap& lap_, latency_histogram& into_):
+                     lap (lap_), into (into_) {}
+      ~latency_timer() { lap.record (into); }
+      latency_timer (const latency_timer&) = delete;
+      latency_timer& operator= (const latency_timer&) = delete;
+};
+
+#endif
@@ -0,0 +1,163 @@
+// $Id: listing.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "debug.h"
+#include "listing.h"
+
+void render_rows (string& out, row_formatter& rows,
+                  const inode_ptr& dir) {
+   const inode* dotdot = dir->get_parent();
+   if (dotdot == nullptr) dotdot = dir.get();
+   rows.append (out, dir->get_inode_nr(), dir->size(), "./");
+   rows.append (out, dotdot->get_inode_nr(), dotdot->size(), "../");
+   for (const auto& pair: dir->get_lower()) {
+      const inode_ptr& child = pair.second;
+      rows.append (out, child->get_inode_nr(), child->size(),
+                   pair.first.name(), pair.first.is_dir());
+   }
+}
+
+// tree_lister -
+//    The state of one lsr.  The writer walks the tree with a
+//    tree_walker, collecting up to BATCH directories without holding
+//    the lock, then queues them as blocks all at once; workers claim
+//    blocks in queue order and render them; the writer writes out
+//    the finished blocks at the front, and waits for the oldest only
+//    when the walk is over or WINDOW blocks are pending.  Blocks are
+//    never moved while queued, so a worker renders into its block
+//    without holding the lock.  The writer looks at each directory's
+//    children before queueing it, so a lazily mounted directory is
+//    filled in here and workers only ever read.
+
+class tree_lister {
+   private:
+      static constexpr size_t WINDOW {1024};
+      static constexpr size_t BATCH {32};
+      struct block {
+         inode_ptr dir;
+         string path;
+         string text;
+         bool done {false};
+      };
+      ostream& out;
+      tree_walker walk;
+      mutex lock;
+      condition_variable queued;
+      condition_variable rendered;
+      deque<block> blocks;
+      size_t first {0};
+      size_t claimed {0};
+      bool stopping {false};
+      void render (block& job, row_formatter& rows);
+      void work();
+   public:
+      tree_lister (ostream& out_, const inode_ptr& dir,
+                   const string& path);
+      void serial();
+      void parallel (size_t jobs);
+};
+
+tree_lister::tree_lister (ostream& out_, const inode_ptr& dir,
+                          const string& path):
+             out (out_), walk (dir, path) {
+}
+
+void tree_lister::render (block& job, row_formatter& rows) {
+   job.text.append (job.path).append (":\n");
+   render_rows (job.text, rows, job.dir);
+}
+
+void tree_lister::serial() {
+   row_formatter rows;
+   block job;
+   while (walk.next()) {
+      job.dir = walk.dir();
+      job.path = walk.path();
+      job.text.clear();
+      render (job, rows);
+      out.write (job.text.data(),
+                 static_cast<streamsize> (job.text.size()));
+   }
+}
+
+void tree_lister::work() {
+   row_formatter rows;
+   unique_lock<mutex> guard (lock);
+   for (;;) {
+      queued.wait (guard, [this] {
+         return stopping or claimed < first + blocks.size();
+      });
+      if (claimed == first + blocks.size()) return;
+      block& job = blocks[claimed++ - first];
+      guard.unlock();
+      render (job, rows);
+      guard.lock();
+      job.done = true;
+      rendered.notify_one();
+   }
+}
+
+void tree_lister::parallel (size_t jobs) {
+   vector<thread> workers;
+   for (size_t count = 0; count < jobs; ++count) {
+      workers.emplace_back (&tree_lister::work, this);
+   }
+   vector<block> batch;
+   vector<string> texts;
+   size_t pending = 0;
+   bool walking = true;
+   for (;;) {
+      batch.clear();
+      while (walking and batch.size() < BATCH
+             and pending + batch.size() < WINDOW) {
+         walking = walk.next();
+         if (not walking) break;
+         walk.dir()->get_lower();
+         batch.emplace_back();
+         batch.back().dir = walk.dir();
+         batch.back().path = walk.path();
+      }
+      unique_lock<mutex> guard (lock);
+      for (auto& job: batch) blocks.push_back (move (job));
+      pending += batch.size();
+      if (not batch.empty()) queued.notify_all();
+      if (pending == 0) {
+         stopping = true;
+         break;
+      }
+      if (not walking or pending == WINDOW) {
+         rendered.wait (guard, [this] { return blocks.front().done; });
+      }
+      while (not blocks.empty() and blocks.front().done) {
+         texts.push_back (move (blocks.front().text));
+         blocks.pop_front();
+         ++first;
+      }
+      guard.unlock();
+      pending -= texts.size();
+      for (const auto& text: texts) {
+         out.write (text.data(),
+                    static_cast<streamsize> (text.size()));
+      }
+      texts.clear();
+   }
+   queued.notify_all();
+   for (auto& worker: workers) worker.join();
+}
+
+void list_tree (ostream& out, const inode_ptr& dir,
+                const string& path, size_t jobs) {
+   DEBUGF ('l', "path = " << path << ", jobs = " << jobs);
+   tree_lister lister (out, dir, path);
+   if (jobs > 1) lister.parallel (jobs);
+           else lister.serial();
+}
+
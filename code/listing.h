@@ -0,0 +1,37 @@
+// $Id: listing.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// listing -
+//    Renders the bodies of ls and lsr.  lsr can spread the work over
+//    several threads; the output is the same either way.
+
+#ifndef __LISTING_H__
+#define __LISTING_H__
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+#include "file_sys.h"
+#include "output.h"
+
+// render_rows -
+//    Appends the rows of one directory to out:  dot and dotdot, then
+//    every child in order.  Sizes come from the dirent counts and
+//    file lengths, which are O(1).  A directory whose parent is gone
+//    lists itself as its own dotdot, like the root.
+// list_tree -
+//    Writes the lsr listing of dir and every directory below it, in
+//    preorder, each block headed by its path and a colon.  path is
+//    how dir itself is shown.  With jobs > 1, that many worker
+//    threads render blocks into their own buffers, never more than
+//    WINDOW blocks ahead of the writer, and the calling thread writes
+//    the buffers out in preorder.
+
+void render_rows (string& out, row_formatter& rows,
+                  const inode_ptr& dir);
+void list_tree (ostream& out, const inode_ptr& dir,
+                const string& path, size_t jobs);
+
+#endif
+
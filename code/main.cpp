@@ -2,8 +2,11 @@
 
 // Evan Clark, Brady Chan
 
+#include <chrono>
 #include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
 #include <unistd.h>
@@ -13,20 +16,73 @@ using namespace std;
 #include "commands.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "output.h"
+#include "script.h"
 #include "util.h"
 
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:  -@flags sets debug flags, -u flushes output
+//    after every line even when cout is not a terminal, -j N runs
+//    lsr on N threads, -f script runs a script file in batch mode
+//    instead of reading commands from cin, -l snapshot loads a saved
+//    tree before the first command, -m snapshot mounts one
+//    read-only instead, and -J base keeps the tree in base.snap and
+//    the journal base.jnl, restoring it at startup.  -t writes the
+//    latency of each builtin to cerr at exit, as tab separated
+//    lines.  Without -j, YSH_JOBS is used if set.
+
+bool line_flush = false;
+size_t lsr_jobs = 1;
+string script_name;
+string snapshot_name;
+bool read_only_mount = false;
+string journal_base;
+bool dump_stats = false;
+
+size_t parse_jobs (const char* text) {
+   char* end = nullptr;
+   unsigned long jobs = strtoul (text, &end, 10);
+   if (end == text or *end != '\0' or jobs == 0) {
+      complain() << "-j " << text << ": invalid job count" << endl;
+      return 1;
+   }
+   return jobs;
+}
 
 void scan_options (int argc, char** argv) {
    opterr = 0;
+   const char* jobs_env = getenv ("YSH_JOBS");
+   if (jobs_env != nullptr) lsr_jobs = parse_jobs (jobs_env);
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:f:J:j:l:m:tu");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'f':
+            script_name = optarg;
+            break;
+         case 'J':
+            journal_base = optarg;
+            break;
+         case 'j':
+            lsr_jobs = parse_jobs (optarg);
+            break;
+         case 'l':
+            snapshot_name = optarg;
+            read_only_mount = false;
+            break;
+         case 'm':
+            snapshot_name = optarg;
+            read_only_mount = true;
+            break;
+         case 't':
+            dump_stats = true;
+            break;
+         case 'u':
+            line_flush = true;
+            break;
          default:
             complain() << "-" << static_cast<char> (option)
                        << ": invalid option" << endl;
@@ -39,8 +95,78 @@ void scan_options (int argc, char** argv) {
 }
 
 
+// interactive -
+//    Loops reading commands from cin until end of file, printing the
+//    prompt and echoing each line if need be.
+
+void interactive (inode_state& state, bool need_echo) {
+   string line;
+   for (;;) {
+      try {
+         // Read a line, break at EOF, and echo print the prompt
+         // if one is needed.
+         cout << state.prompt();
+         getline (cin, line);
+         if (cin.eof()) {
+            if (need_echo) cout << "^D";
+            cout << endl;
+            DEBUGF ('y', "EOF");
+            break;
+         }
+         if (need_echo) cout << line << endl;
+
+         // Split the line into words and lookup the appropriate
+         // function.  Complain or call it.
+         wordvec words = split (line, " \t");
+         DEBUGF ('y', "words = " << words);
+         command_id command = find_command (words.at(0));
+         latency_lap lap;
+         run_command (command, state, words, lap);
+         cout.flush();
+      }catch (file_error& error) {
+         complain() << error.what() << endl;
+      }catch (command_error& error) {
+         complain() << error.what() << endl;
+      }
+   }
+}
+
+// run_script -
+//    Batch mode:  runs a script file with no prompt and no echo,
+//    then reports on cerr how many commands ran and the wall time,
+//    counting the load and tokenizing.  Output is flushed only when
+//    the buffer fills, or before an error message through the tie
+//    between cerr and cout.
+
+void run_script (inode_state& state, const string& filename) {
+   auto start = chrono::steady_clock::now();
+   unique_ptr<script> batch;
+   try {
+      batch = make_unique<script> (filename);
+   }catch (command_error& error) {
+      complain() << error.what() << endl;
+      return;
+   }
+   auto report = [&] {
+      chrono::duration<double> elapsed =
+            chrono::steady_clock::now() - start;
+      cout.flush();
+      cerr << exec::execname() << ": " << batch->executed()
+           << " commands in " << fixed << setprecision (3)
+           << elapsed.count() << " s" << endl;
+   };
+   try {
+      batch->run (state);
+   }catch (ysh_exit&) {
+      report();
+      throw;
+   }
+   report();
+}
+
 // main -
-//    Main program which loops reading commands until end of file.
+//    Main program which runs a script or loops reading commands
+//    until end of file.
 
 int main (int argc, char** argv) {
    exec::execname (argv[0]);
@@ -49,39 +175,39 @@ int main (int argc, char** argv) {
    cout << argv[0] << " build " << __DATE__ << " " << __TIME__ << endl;
    scan_options (argc, argv);
    bool need_echo = want_echo();
+
+   // Commands write to cout through one large buffer, written once
+   // per command, or once per line on a terminal or with -u.
+   constexpr int COUT_FD {1};
+   output_sink sink (COUT_FD, line_flush or isatty (COUT_FD)
+                     ? output_sink::mode::LINE
+                     : output_sink::mode::BATCH);
+   streambuf* cout_buf = cout.rdbuf (&sink);
    inode_state state;
+   state.set_lsr_jobs (lsr_jobs);
+   if (not journal_base.empty() and not snapshot_name.empty()) {
+      complain() << "-J: ignoring " << snapshot_name << endl;
+      snapshot_name.clear();
+   }
    try {
-      for (;;) {
-         try {
-            // Read a line, break at EOF, and echo print the prompt
-            // if one is needed.
-            cout << state.prompt();
-            string line;
-            getline (cin, line);
-            if (cin.eof()) {
-               if (need_echo) cout << "^D";
-               cout << endl;
-               DEBUGF ('y', "EOF");
-               break;
-            }
-            if (need_echo) cout << line << endl;
-   
-            // Split the line into words and lookup the appropriate
-            // function.  Complain or call it.
-            wordvec words = split (line, " \t");
-            DEBUGF ('y', "words = " << words);
-            command_fn fn = find_command_fn (words.at(0));
-            fn (state, words);
-         }catch (file_error& error) {
-            complain() << error.what() << endl;
-         }catch (command_error& error) {
-            complain() << error.what() << endl;
-         }
+      if (not journal_base.empty()) state.open_journal (journal_base);
+      if (not snapshot_name.empty()) {
+         if (read_only_mount) state.mount (snapshot_name);
+                         else state.load (snapshot_name);
       }
+   }catch (file_error& error) {
+      complain() << error.what() << endl;
+   }
+   try {
+      if (script_name.empty()) interactive (state, need_echo);
+                          else run_script (state, script_name);
    } catch (ysh_exit&) {
       // This catch intentionally left blank.
    }
 
-   return exit_status_message();
+   int status = exit_status_message();
+   cout.flush();
+   if (dump_stats) dump_command_stats (cerr);
+   cout.rdbuf (cout_buf);
+   return status;
 }
-
@@ -0,0 +1,192 @@
+// $Id: names.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <cstring>
+#include <iomanip>
+
+using namespace std;
+
+#include "debug.h"
+#include "file_sys.h"
+#include "names.h"
+
+vector<unique_ptr<char[]>> name_table::chunks_;
+size_t name_table::chunk_used_ {0};
+size_t name_table::text_bytes_ {0};
+array<unique_ptr<name_table::slot[]>,name_table::MAX_PAGES>
+      name_table::pages_;
+size_t name_table::count_ {0};
+unordered_map<string_view,name_id> name_table::ids_;
+vector<name_id> name_table::free_ids_;
+unordered_map<size_t,vector<char*>> name_table::free_text_;
+mutex name_table::unused_lock_;
+vector<name_id> name_table::unused_;
+atomic<bool> name_table::any_unused_ {false};
+atomic<size_t> name_table::refs_ {0};
+atomic<size_t> name_table::string_bytes_ {0};
+
+// string_cost -
+//    What one std::string holding a name of this length costs:
+//    the object itself plus a heap block if it is too long for the
+//    small string buffer.
+
+size_t string_cost (size_t length) {
+   static const size_t inline_capacity = string().capacity();
+   size_t cost = sizeof (string);
+   if (length > inline_capacity) cost += length + 1;
+   return cost;
+}
+
+// name_table::store -
+//    Copies the characters into the bytes of a freed name of the
+//    same length, or else into the current chunk, starting a new
+//    one when it is full.  Names longer than a chunk get their own.
+
+string_view name_table::store (string_view name) {
+   text_bytes_ += name.size();
+   auto spare = free_text_.find (name.size());
+   if (spare != free_text_.end() and not spare->second.empty()) {
+      char* text = spare->second.back();
+      spare->second.pop_back();
+      memcpy (text, name.data(), name.size());
+      return string_view (text, name.size());
+   }
+   if (chunks_.empty() or chunk_used_ + name.size() > CHUNK_SIZE) {
+      size_t size = max (CHUNK_SIZE, name.size());
+      chunks_.push_back (make_unique<char[]> (size));
+      chunk_used_ = 0;
+   }
+   char* text = chunks_.back().get() + chunk_used_;
+   memcpy (text, name.data(), name.size());
+   chunk_used_ += name.size();
+   return string_view (text, name.size());
+}
+
+// name_table::drop -
+//    The last user of a name queues it for the shell thread, which
+//    alone touches the index.  A name can be queued more than once
+//    if it is held again and dropped again before it is freed.
+
+void name_table::drop (name_id id) {
+   if (--at (id).users != 0) return;
+   lock_guard<mutex> guard (unused_lock_);
+   unused_.push_back (id);
+   any_unused_ = true;
+}
+
+// name_table::free_unused -
+//    Frees the queued names that nobody has held since, putting
+//    their handles and bytes up for reuse.  A freed slot has no
+//    text, so a name queued twice is freed once.
+
+void name_table::free_unused() {
+   vector<name_id> queued;
+   {
+      lock_guard<mutex> guard (unused_lock_);
+      queued.swap (unused_);
+      any_unused_ = false;
+   }
+   for (name_id id: queued) {
+      slot& entry = at (id);
+      if (entry.users != 0 or entry.text.data() == nullptr) continue;
+      DEBUGF ('n', "free " << id << " = \"" << entry.text << "\"");
+      ids_.erase (entry.text);
+      free_text_[entry.text.size()]
+            .push_back (const_cast<char*> (entry.text.data()));
+      text_bytes_ -= entry.text.size();
+      entry.text = string_view();
+      free_ids_.push_back (id);
+   }
+}
+
+name_id name_table::intern (string_view name) {
+   if (any_unused_) free_unused();
+   auto found = ids_.find (name);
+   if (found != ids_.end()) return found->second;
+   name_id id;
+   if (not free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+   } else if (count_ < MAX_PAGES * PAGE_SIZE) {
+      id = count_++;
+      unique_ptr<slot[]>& page = pages_[id >> PAGE_BITS];
+      if (page == nullptr) page = make_unique<slot[]> (PAGE_SIZE);
+   } else {
+      throw file_error ("name table full");
+   }
+   string_view text = store (name);
+   at (id).text = text;
+   ids_.emplace (text, id);
+   DEBUGF ('n', "intern " << id << " = \"" << text << "\"");
+   return id;
+}
+
+bool name_table::find (string_view name, name_id& id) {
+   auto found = ids_.find (name);
+   if (found == ids_.end()) return false;
+   id = found->second;
+   return true;
+}
+
+// Each inode used to hold its name in a string, and its parent's
+// dirent held the same name again as the key.
+
+void name_table::retain (name_id id, bool is_dir) {
+   hold (id);
+   ++refs_;
+   string_bytes_ += 2 * string_cost (text (id).size() + is_dir);
+}
+
+void name_table::release (name_id id, bool is_dir) {
+   --refs_;
+   string_bytes_ -= 2 * string_cost (text (id).size() + is_dir);
+   drop (id);
+}
+
+void name_table::report (ostream& out) {
+   size_t handle_bytes = refs_.load() * (sizeof (dirent_key)
+                                + sizeof (name_id));
+   size_t pool_bytes = chunks_.size() * CHUNK_SIZE
+                     + (count_ + PAGE_SIZE - 1) / PAGE_SIZE
+                     * PAGE_SIZE * sizeof (slot)
+                     + ids_.bucket_count() * sizeof (void*)
+                     + ids_.size() * (sizeof (void*)
+                       + sizeof (pair<string_view,name_id>));
+   long saved = static_cast<long> (string_bytes_.load())
+              - static_cast<long> (handle_bytes + pool_bytes);
+   out << "names:        " << setw (12)
+       << count_ - free_ids_.size() << '\n'
+       << "name bytes:   " << setw (12) << text_bytes_ << '\n'
+       << "references:   " << setw (12) << refs_.load() << '\n'
+       << "as strings:   " << setw (12) << string_bytes_.load() << '\n'
+       << "as handles:   " << setw (12) << handle_bytes << '\n'
+       << "pool:         " << setw (12) << pool_bytes << '\n'
+       << "bytes saved:  " << setw (12) << saved << '\n';
+}
+
+// compare -
+//    Three-way comparison of two keys in the order of the strings
+//    "name" or "name/" that they stand for.  Names never contain a
+//    slash, so the slash only matters once one name runs out.
+
+int compare (dirent_key left, dirent_key right) {
+   if (left.bits == right.bits) return 0;
+   string_view lname = left.name();
+   string_view rname = right.name();
+   size_t common = min (lname.size(), rname.size());
+   int cmp = lname.substr (0, common)
+                  .compare (rname.substr (0, common));
+   if (cmp != 0) return cmp;
+   unsigned char lnext = lname.size() > common
+                       ? lname[common] : left.is_dir() ? '/' : 0;
+   unsigned char rnext = rname.size() > common
+                       ? rname[common] : right.is_dir() ? '/' : 0;
+   return static_cast<int> (lnext) - static_cast<int> (rnext);
+}
+
+ostream& operator<< (ostream& out, dirent_key key) {
+   out << key.name();
+   if (key.is_dir()) out << '/';
+   return out;
+}
+
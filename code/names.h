@@ -0,0 +1,113 @@
+// $Id: names.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// names -
+//    Interned file names.  Every distinct name is stored once in a
+//    global table, and dirents and inodes refer to it through a
+//    small integer handle.
+
+#ifndef __NAMES_H__
+#define __NAMES_H__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+using name_id = uint32_t;
+
+// name_table -
+//    static class holding the pool of interned names.
+// intern -
+//    Returns the handle for a name, adding it to the pool if needed.
+//    Throws file_error if every handle is in use.  The caller must
+//    hold the name before its next intern, or it may be freed.
+// find -
+//    Looks a name up without adding it.  Returns false if the name
+//    is not in the pool, in which case no dirent can have it.
+// text -
+//    The characters of an interned name.  Views stay valid while
+//    the name is held.  The index is a fixed table of pages that
+//    never moves, so text may be called from the reclaimer thread
+//    while the shell interns new names.
+// hold, drop -
+//    Count the users of a name.  A name whose count falls to zero
+//    is freed at the next intern, which reuses its handle and its
+//    bytes.  Drop is safe from any thread; hold, like intern, is
+//    for the shell thread.
+// retain, release -
+//    Hold and drop for an inode, also counted for the memory report.
+// report -
+//    Prints the size of the pool and an estimate of the bytes
+//    saved over holding each name in its own pair of strings.
+
+class name_table {
+   private:
+      static constexpr size_t CHUNK_SIZE {64 * 1024};
+      static vector<unique_ptr<char[]>> chunks_;
+      static size_t chunk_used_;
+      static size_t text_bytes_;
+      static constexpr size_t PAGE_BITS {12};
+      static constexpr size_t PAGE_SIZE {size_t (1) << PAGE_BITS};
+      static constexpr size_t MAX_PAGES {size_t (1) << 16};
+      struct slot {
+         string_view text;
+         atomic<uint32_t> users {0};
+      };
+      static array<unique_ptr<slot[]>,MAX_PAGES> pages_;
+      static size_t count_;
+      static unordered_map<string_view,name_id> ids_;
+      static vector<name_id> free_ids_;
+      static unordered_map<size_t,vector<char*>> free_text_;
+      static mutex unused_lock_;
+      static vector<name_id> unused_;
+      static atomic<bool> any_unused_;
+      static atomic<size_t> refs_;
+      static atomic<size_t> string_bytes_;
+      static slot& at (name_id id) {
+         return pages_[id >> PAGE_BITS][id & (PAGE_SIZE - 1)];
+      }
+      static string_view store (string_view name);
+      static void free_unused();
+   public:
+      static name_id intern (string_view name);
+      static bool find (string_view name, name_id& id);
+      static string_view text (name_id id) { return at (id).text; }
+      static void hold (name_id id) { ++at (id).users; }
+      static void drop (name_id id);
+      static void retain (name_id id, bool is_dir);
+      static void release (name_id id, bool is_dir);
+      static void report (ostream& out);
+};
+
+// dirent_key -
+//    Key of a dirent: a name handle plus a flag which is set for a
+//    subdirectory.  A subdirectory sorts and prints as if its name
+//    ended in a slash, "name/", though the slash is never stored.
+
+class dirent_key {
+   private:
+      uint32_t bits;
+   public:
+      dirent_key (name_id id, bool is_dir):
+                  bits ((id << 1) | (is_dir ? 1 : 0)) {}
+      name_id id() const { return bits >> 1; }
+      bool is_dir() const { return bits & 1; }
+      string_view name() const { return name_table::text (id()); }
+      bool operator== (dirent_key that) const {
+         return bits == that.bits;
+      }
+      friend int compare (dirent_key left, dirent_key right);
+};
+
+int compare (dirent_key left, dirent_key right);
+ostream& operator<< (ostream& out, dirent_key key);
+
+#endif
+
@@ -0,0 +1,132 @@
+// $Id: output.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "output.h"
+
+bool write_all (int fd, const char* data, size_t size) {
+   while (size > 0) {
+      ssize_t written = ::write (fd, data, size);
+      if (written < 0) {
+         if (errno == EINTR) continue;
+         int saved = errno;
+         DEBUGF ('o', "write: " << strerror (saved));
+         errno = saved;
+         return false;
+      }
+      data += written;
+      size -= static_cast<size_t> (written);
+   }
+   return true;
+}
+
+output_sink::output_sink (int fd_, mode how, size_t capacity):
+            fd (fd_), mode_ (how), buffer (capacity) {
+   set_used (0);
+}
+
+output_sink::~output_sink() {
+   drain();
+}
+
+void output_sink::set_mode (mode how) {
+   drain();
+   mode_ = how;
+   set_used (0);
+}
+
+// set_used -
+//    Resets the put area with used bytes already in the buffer.  In
+//    LINE mode the put area ends at the put pointer, so every sputc
+//    comes through overflow and a newline is seen at once.
+
+void output_sink::set_used (size_t used) {
+   char* base = buffer.data();
+   setp (base, base + (mode_ == mode::LINE ? used : buffer.size()));
+   pbump (static_cast<int> (used));
+}
+
+// drain -
+//    Writes the buffered bytes and empties the buffer.
+
+bool output_sink::drain() {
+   size_t used = static_cast<size_t> (pptr() - pbase());
+   bool good = write_all (fd, pbase(), used);
+   set_used (0);
+   return good;
+}
+
+output_sink::int_type output_sink::overflow (int_type ch) {
+   if (traits_type::eq_int_type (ch, traits_type::eof())) {
+      return drain() ? traits_type::not_eof (ch) : traits_type::eof();
+   }
+   size_t used = static_cast<size_t> (pptr() - pbase());
+   if (used == buffer.size()) {
+      if (not drain()) return traits_type::eof();
+      used = 0;
+   }
+   char byte = traits_type::to_char_type (ch);
+   buffer[used] = byte;
+   set_used (used + 1);
+   if (mode_ == mode::LINE and byte == '\n' and not drain()) {
+      return traits_type::eof();
+   }
+   return ch;
+}
+
+streamsize output_sink::xsputn (const char* data, streamsize size) {
+   size_t length = static_cast<size_t> (size);
+   size_t used = static_cast<size_t> (pptr() - pbase());
+   if (length > buffer.size() - used) {
+      if (not drain()) return 0;
+      used = 0;
+      if (length >= buffer.size()) {
+         return write_all (fd, data, length) ? size : 0;
+      }
+   }
+   memcpy (buffer.data() + used, data, length);
+   set_used (used + length);
+   if (mode_ == mode::LINE and memchr (data, '\n', length) != nullptr
+       and not drain()) return 0;
+   return size;
+}
+
+int output_sink::sync() {
+   return drain() ? 0 : -1;
+}
+
+row_formatter::row_formatter() {
+   row.reserve (256);
+}
+
+void row_formatter::append (string& out, size_t inode_nr, size_t size,
+                            string_view name, bool slash) {
+   char digits[24];
+   out.append (5, ' ');
+   char* last = to_chars (begin (digits), end (digits), inode_nr).ptr;
+   out.append (digits, last);
+   last = to_chars (begin (digits), end (digits), size).ptr;
+   size_t width = static_cast<size_t> (last - digits);
+   if (width < SIZE_COLUMNS) out.append (SIZE_COLUMNS - width, ' ');
+   out.append (digits, last);
+   out.append ("  ");
+   out.append (name);
+   if (slash) out.push_back ('/');
+   out.push_back ('\n');
+}
+
+void row_formatter::put (ostream& out, size_t inode_nr, size_t size,
+                         string_view name, bool slash) {
+   row.clear();
+   append (row, inode_nr, size, name, slash);
+   out.write (row.data(), static_cast<streamsize> (row.size()));
+}
+
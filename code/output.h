@@ -0,0 +1,86 @@
+// $Id: output.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// output -
+//    Buffered sink for everything the shell writes to stdout.  It is
+//    installed as the streambuf behind cout, so commands keep writing
+//    with <<, but lines collect in one large buffer and reach the
+//    file descriptor in a few big writes instead of one per line.
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// write_all -
+//    Writes all of data to fd, retrying short writes and interrupts.
+//    Returns false on an error, with errno set.
+
+bool write_all (int fd, const char* data, size_t size);
+
+// output_sink -
+//    A streambuf over a file descriptor.
+// mode -
+//    BATCH writes only when the buffer fills or on an explicit
+//    flush, which main does once per command.  LINE also writes
+//    after every newline, for an interactive terminal.
+// capacity -
+//    Buffer size in bytes, and so the threshold for a write in
+//    BATCH mode.  Writes larger than the buffer bypass it.
+// sync -
+//    Called by ostream::flush, endl, and by cerr and cin through
+//    their tie to cout.  Writes whatever is buffered.
+// dtor -
+//    Writes whatever is buffered.  Does not close the descriptor.
+
+class output_sink: public streambuf {
+   public:
+      enum class mode {BATCH, LINE};
+      static constexpr size_t DEFAULT_CAPACITY {1 << 16};
+   private:
+      int fd;
+      mode mode_;
+      vector<char> buffer;
+      void set_used (size_t used);
+      bool drain();
+   protected:
+      int_type overflow (int_type ch) override;
+      streamsize xsputn (const char* data, streamsize size) override;
+      int sync() override;
+   public:
+      output_sink (int fd, mode how,
+                   size_t capacity = DEFAULT_CAPACITY);
+      output_sink (const output_sink&) = delete;
+      output_sink& operator= (const output_sink&) = delete;
+      ~output_sink();
+      mode get_mode() const { return mode_; }
+      void set_mode (mode how);
+};
+
+// row_formatter -
+//    Renders the rows of an ls listing into one reused buffer, with
+//    integers converted by to_chars rather than stream manipulators.
+//    A row is five spaces, the inode number, the size right-justified
+//    in eight columns, two spaces, and the name.  A trailing slash is
+//    added to directory names when asked.  append adds the row to a
+//    string; put sends it to a stream in a single write.
+
+class row_formatter {
+   private:
+      static constexpr size_t SIZE_COLUMNS {8};
+      string row;
+   public:
+      row_formatter();
+      void append (string& out, size_t inode_nr, size_t size,
+                   string_view name, bool slash = false);
+      void put (ostream& out, size_t inode_nr, size_t size,
+                string_view name, bool slash = false);
+};
+
+#endif
+
@@ -0,0 +1,97 @@
+// $Id: reclaim.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <vector>
+
+using namespace std;
+
+#include "debug.h"
+#include "reclaim.h"
+
+reclaimer::reclaimer(): worker (&reclaimer::run, this) {
+}
+
+reclaimer::~reclaimer() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   wakeup.notify_one();
+   worker.join();
+}
+
+void reclaimer::retire (inode_ptr subtree) {
+   if (subtree.use_count() > 1) return;
+   pending_ += subtree->footprint();
+   {
+      lock_guard<mutex> guard (lock);
+      queue.push_back (move (subtree));
+   }
+   wakeup.notify_one();
+}
+
+void reclaimer::sync() {
+   unique_lock<mutex> guard (lock);
+   drained.wait (guard, [this] { return queue.empty() and not busy; });
+}
+
+size_t reclaimer::queued() {
+   lock_guard<mutex> guard (lock);
+   return queue.size() + (busy ? 1 : 0);
+}
+
+void reclaimer::run() {
+   unique_lock<mutex> guard (lock);
+   for (;;) {
+      wakeup.wait (guard, [this] {
+         return stopping or not queue.empty();
+      });
+      if (queue.empty()) break;
+      inode_ptr subtree = move (queue.front());
+      queue.pop_front();
+      busy = true;
+      guard.unlock();
+      reclaim (move (subtree));
+      guard.lock();
+      busy = false;
+      if (queue.empty()) drained.notify_all();
+   }
+}
+
+// reclaimer::reclaim -
+//    The same work list as dismantle, keeping the byte count up to
+//    date and yielding between batches.  Only inodes held by nothing
+//    else go on the list.  The use count is tested before anything
+//    else in a child is read, since an inode still held elsewhere
+//    may be in use on the shell thread; its reference is dropped
+//    and nothing more.
+
+void reclaimer::reclaim (inode_ptr subtree) {
+   vector<inode_ptr> work;
+   work.push_back (move (subtree));
+   size_t batch = 0;
+   while (not work.empty()) {
+      inode_ptr node = move (work.back());
+      work.pop_back();
+      size_t bytes = node->footprint();
+      size_t kept = work.size();
+      node->detach_lower (work);
+      for (size_t child = kept; child < work.size(); ++child) {
+         if (work[child].use_count() > 1) continue;
+         pending_ += work[child]->footprint();
+         if (child != kept) work[kept] = move (work[child]);
+         ++kept;
+      }
+      work.resize (kept);
+      node = nullptr;
+      ++freed_;
+      pending_ -= bytes;
+      if (++batch == BATCH_SIZE) {
+         batch = 0;
+         this_thread::yield();
+      }
+   }
+   DEBUGF ('r', "freed " << freed_ << " inodes, "
+           << pending_ << " bytes pending");
+}
+
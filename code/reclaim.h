@@ -0,0 +1,68 @@
+// $Id: reclaim.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// reclaim -
+//    Background reclamation of removed subtrees.  rm and rmr detach
+//    a subtree from the tree and hand it over here, so the command
+//    returns at once and a worker thread frees it.
+
+#ifndef __RECLAIM_H__
+#define __RECLAIM_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include "file_sys.h"
+
+// reclaimer -
+//    Owns a queue of detached subtrees and the thread that frees
+//    them, BATCH_SIZE inodes at a time.
+// retire -
+//    Queues a subtree.  O(1):  the caller must already have
+//    unlinked it, and no inode in it may be reachable from the tree
+//    or held by anything else on the shell thread.  A subtree whose
+//    top is still held elsewhere is not queued; the reference is
+//    just dropped.
+// sync -
+//    Waits until everything queued so far has been freed.
+// pending_bytes -
+//    Bytes known to be waiting to be freed.  A queued subtree is
+//    charged for its top inode at once and for each lower inode as
+//    the worker reaches it, so this is exact once the worker has
+//    finished a subtree and a lower bound while it is working.
+// dtor -
+//    Finishes the queue and joins the thread.
+
+class reclaimer {
+   private:
+      static constexpr size_t BATCH_SIZE {4096};
+      mutex lock;
+      condition_variable wakeup;
+      condition_variable drained;
+      deque<inode_ptr> queue;
+      bool busy {false};
+      bool stopping {false};
+      atomic<size_t> pending_ {0};
+      atomic<size_t> freed_ {0};
+      thread worker;
+      void run();
+      void reclaim (inode_ptr subtree);
+   public:
+      reclaimer();
+      ~reclaimer();
+      reclaimer (const reclaimer&) = delete;
+      reclaimer& operator= (const reclaimer&) = delete;
+      void retire (inode_ptr subtree);
+      void sync();
+      size_t pending_bytes() const { return pending_; }
+      size_t freed_inodes() const { return freed_; }
+      size_t queued();
+};
+
+#endif
+
@@ -0,0 +1,93 @@
+// $Id: rmrstress.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// rmrstress -
+//    Builds a chain of nested directories, default 1000000 deep,
+//    and tears it down four ways:  by rmr, by rmr of the directory
+//    holding cwd and then a cd away from it, and by letting the
+//    shell state go out of scope as it does at exit, both with the
+//    chain in place and with cwd holding a removed chain.  Reports
+//    how many inodes each teardown reclaimed and how long it took.
+//    All would overflow the stack if subtrees were freed
+//    recursively.
+//    Usage:  rmrstress [depth]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "file_sys.h"
+
+using stress_clock = chrono::steady_clock;
+
+double seconds_since (stress_clock::time_point start) {
+   chrono::duration<double> elapsed = stress_clock::now() - start;
+   return elapsed.count();
+}
+
+void build_chain (inode_state& state, size_t depth) {
+   auto start = stress_clock::now();
+   for (size_t level = 0; level < depth; ++level) {
+      state.make_directory ("d");
+      state.change_directory ("d");
+   }
+   state.change_directory ("");
+   cout << "built " << depth << " levels in "
+        << seconds_since (start) << " s, "
+        << inode::live() << " live inodes" << endl;
+}
+
+// remove_under_cwd -
+//    Removes the chain while cwd is its top directory, so cwd is
+//    left holding all of it.
+
+void remove_under_cwd (inode_state& state) {
+   state.change_directory ("d");
+   state.rmr ("/d");
+}
+
+void report (const char* how, size_t before,
+             stress_clock::time_point start) {
+   cout << how << " reclaimed " << before - inode::live()
+        << " inodes in " << seconds_since (start) << " s" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t depth = argc > 1 ? stoul (argv[1]) : 1000000;
+   stress_clock::time_point start;
+   size_t before = 0;
+   {
+      inode_state state;
+      build_chain (state, depth);
+      before = inode::live();
+      start = stress_clock::now();
+      state.rmr ("d");
+      cout << "rmr returned in " << seconds_since (start) << " s"
+           << endl;
+      state.sync();
+      report ("rmr", before, start);
+      build_chain (state, depth);
+      remove_under_cwd (state);
+      before = inode::live();
+      start = stress_clock::now();
+      state.change_directory ("");
+      state.sync();
+      report ("cd", before, start);
+      build_chain (state, depth);
+      before = inode::live();
+      start = stress_clock::now();
+   }
+   report ("exit", before, start);
+   {
+      inode_state state;
+      build_chain (state, depth);
+      remove_under_cwd (state);
+      before = inode::live();
+      start = stress_clock::now();
+   }
+   report ("exit with removed cwd", before, start);
+   return inode::live() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
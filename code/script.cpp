@@ -0,0 +1,140 @@
+// $Id: script.cpp,v 1.2 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "script.h"
+
+script::script (const string& filename) {
+   bool from_cin = filename == "-";
+   int fd = from_cin ? STDIN_FILENO : open (filename.c_str(), O_RDONLY);
+   if (fd < 0) {
+      throw command_error (filename + ": " + strerror (errno));
+   }
+   try {
+      load (fd, filename);
+   }catch (...) {
+      if (not from_cin) close (fd);
+      throw;
+   }
+   if (not from_cin) close (fd);
+   if (text.size() > numeric_limits<uint32_t>::max()) {
+      throw command_error (filename + ": script too large");
+   }
+   tokenize();
+   DEBUGF ('s', filename << ": " << commands.size() << " commands, "
+           << words.size() << " words, "
+           << (mapped != nullptr ? "mapped" : "read"));
+}
+
+script::~script() {
+   if (mapped != nullptr) munmap (mapped, mapped_size);
+}
+
+// script::load -
+//    Maps a non-empty regular file read-only.  If it is not one, or
+//    the map fails, reads to end of file instead.
+
+void script::load (int fd, const string& filename) {
+   struct stat info;
+   if (fstat (fd, &info) == 0 and S_ISREG (info.st_mode)
+       and info.st_size > 0) {
+      size_t size = static_cast<size_t> (info.st_size);
+      void* addr = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+         madvise (addr, size, MADV_SEQUENTIAL);
+         mapped = addr;
+         mapped_size = size;
+         text = string_view (static_cast<const char*> (addr), size);
+         return;
+      }
+   }
+   for (;;) {
+      size_t used = buffer.size();
+      buffer.resize (used + READ_BLOCK);
+      ssize_t got = read (fd, &buffer[used], READ_BLOCK);
+      size_t kept = got > 0 ? static_cast<size_t> (got) : 0;
+      buffer.resize (used + kept);
+      if (got == 0) break;
+      if (got < 0 and errno != EINTR) {
+         throw command_error (filename + ": " + strerror (errno));
+      }
+   }
+   text = buffer;
+}
+
+// script::tokenize -
+//    One pass over the text.  Each word becomes a span; each
+//    non-blank line becomes a command whose first word is looked up
+//    here, once.
+
+void script::tokenize() {
+   const char* base = text.data();
+   size_t size = text.size();
+   size_t pos = 0;
+   while (pos < size) {
+      uint32_t first = static_cast<uint32_t> (words.size());
+      while (pos < size and base[pos] != '\n') {
+         if (base[pos] == ' ' or base[pos] == '\t') {
+            ++pos;
+            continue;
+         }
+         size_t start = pos;
+         while (pos < size and base[pos] != '\n' and base[pos] != ' '
+                and base[pos] != '\t') ++pos;
+         words.push_back ({static_cast<uint32_t> (start),
+                           static_cast<uint32_t> (pos - start)});
+      }
+      ++pos;
+      uint32_t count = static_cast<uint32_t> (words.size()) - first;
+      if (count == 0) continue;
+      command_id id = UNKNOWN;
+      try {
+         id = find_command (word (words[first]));
+      }catch (command_error&) {
+         // Reported when the command is reached.
+      }
+      commands.push_back ({id, first, count});
+   }
+}
+
+// script::run -
+//    One lap runs through the whole script, so each command is timed
+//    from the end of the one before.  After an error the lap starts
+//    over, leaving the message out of the next command's time.
+
+void script::run (inode_state& state) {
+   wordvec args;
+   latency_lap lap;
+   for (const command& cmd: commands) {
+      ++executed_;
+      try {
+         args.resize (cmd.count);
+         for (uint32_t arg = 0; arg < cmd.count; ++arg) {
+            args[arg] = word (words[cmd.first + arg]);
+         }
+         DEBUGF ('y', "words = " << args);
+         if (cmd.id == UNKNOWN) {
+            throw command_error (string (args[0])
+                                 + ": no such function");
+         }
+         run_command (cmd.id, state, args, lap);
+         continue;
+      }catch (file_error& error) {
+         complain() << error.what() << endl;
+      }catch (command_error& error) {
+         complain() << error.what() << endl;
+      }
+      lap.restart();
+   }
+}
+
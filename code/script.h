@@ -0,0 +1,81 @@
+// $Id: script.h,v 1.2 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// script -
+//    Batch execution of a whole script file, for yshell -f.  A
+//    regular file is mapped into memory; anything else, such as a
+//    pipe or "-" for cin, is read into one buffer in large blocks.
+//    The text is tokenized in a single pass into a flat array of
+//    commands, each a resolved builtin plus a span of
+//    words.  Commands get their words as views into the text, so
+//    running a script copies no words and needs no line buffer, no
+//    split, no table lookup and no prompt.
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+
+// script -
+// ctor -
+//    Maps or reads and then tokenizes the named file.  Throws
+//    command_error if it cannot be read.  Words are separated by
+//    blanks and tabs and commands by newlines, as for interactive
+//    input; blank lines are dropped.  A command name that is not in
+//    the table is kept and reported as an error when its turn comes.
+// dtor -
+//    Unmaps the file.
+// size -
+//    The number of commands.
+// run -
+//    Executes the commands in order against state.  Errors are
+//    reported and execution goes on, as at the prompt.  exit stops
+//    it by throwing ysh_exit.
+// executed -
+//    The number of commands run so far, including any that failed
+//    and the exit that stopped the run.
+
+class script {
+   private:
+      static constexpr size_t READ_BLOCK {1 << 20};
+      struct span {
+         uint32_t offset;
+         uint32_t length;
+      };
+      static constexpr command_id UNKNOWN {~command_id (0)};
+      struct command {
+         command_id id;
+         uint32_t first;
+         uint32_t count;
+      };
+      void* mapped {nullptr};
+      size_t mapped_size {0};
+      string buffer;
+      string_view text;
+      vector<span> words;
+      vector<command> commands;
+      size_t executed_ {0};
+      void load (int fd, const string& filename);
+      void tokenize();
+      string_view word (const span& where) const {
+         return text.substr (where.offset, where.length);
+      }
+   public:
+      explicit script (const string& filename);
+      ~script();
+      script (const script&) = delete;
+      script& operator= (const script&) = delete;
+      size_t size() const { return commands.size(); }
+      void run (inode_state& state);
+      size_t executed() const { return executed_; }
+};
+
+#endif
+
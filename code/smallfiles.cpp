@@ -0,0 +1,69 @@
+// $Id: smallfiles.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// smallfiles -
+//    Builds a tree of small files, default 1000000 of them spread
+//    over 1000 directories, each holding a few words like the files
+//    our scripts make, and then as many empty directories spread the
+//    same way.  Reports the growth in resident memory and the cost
+//    per file and per empty directory.
+//    Usage:  smallfiles [files [dirs]]
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+#include "file_sys.h"
+
+// resident_kb -
+//    VmRSS of this process, from /proc/self/status.
+
+size_t resident_kb() {
+   ifstream status ("/proc/self/status");
+   string line;
+   while (getline (status, line)) {
+      if (line.compare (0, 6, "VmRSS:") == 0) {
+         return stoul (line.substr (6));
+      }
+   }
+   return 0;
+}
+
+int main (int argc, char** argv) {
+   constexpr size_t DIRECTORIES {1000};
+   size_t files = argc > 1 ? stoul (argv[1]) : 1000000;
+   size_t dirs = argc > 2 ? stoul (argv[2]) : files;
+   inode_state state;
+   size_t before = resident_kb();
+   for (size_t dir = 0; dir < DIRECTORIES; ++dir) {
+      state.make_directory ("d" + to_string (dir));
+   }
+   for (size_t file = 0; file < files; ++file) {
+      string path = "d" + to_string (file % DIRECTORIES)
+                  + "/f" + to_string (file);
+      string serial = to_string (file);
+      wordvec words {"make", path, "log", "data", "tmp", serial};
+      state.make_file (words);
+   }
+   size_t after = resident_kb();
+   cout << files << " small files: resident grew by "
+        << (after - before) / 1024 << " MiB, "
+        << (after - before) * 1024 / files << " bytes per file"
+        << endl;
+   if (dirs == 0) return EXIT_SUCCESS;
+   before = after;
+   for (size_t dir = 0; dir < dirs; ++dir) {
+      state.make_directory ("d" + to_string (dir % DIRECTORIES)
+                            + "/e" + to_string (dir));
+   }
+   after = resident_kb();
+   cout << dirs << " empty directories: resident grew by "
+        << (after - before) / 1024 << " MiB, "
+        << (after - before) * 1024 / dirs << " bytes per directory"
+        << endl;
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,514 @@
+// $Id: snapshot.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+#include "arena.h"
+#include "debug.h"
+#include "output.h"
+#include "snapshot.h"
+
+namespace {
+
+constexpr size_t align8 (size_t offset) {
+   return (offset + 7) & ~size_t (7);
+}
+
+file_error snapshot_error (const string& filename, const string& why) {
+   return file_error (filename + ": " + why);
+}
+
+// image -
+//    The tree flattened into the sections of a snapshot.  Building
+//    it reads the tree but copies no file contents; the views stay
+//    valid until the tree is next changed.
+
+struct image {
+   unordered_map<name_id,uint32_t> name_index;
+   vector<snapshot_name> names;
+   string name_text;
+   vector<snapshot_record> records;
+   vector<string_view> contents;
+   uint64_t contents_size {0};
+   uint32_t add_name (name_id id);
+   snapshot_record record_for (const inode* node);
+   explicit image (const inode_ptr& root);
+};
+
+uint32_t image::add_name (name_id id) {
+   auto found = name_index.find (id);
+   if (found != name_index.end()) return found->second;
+   string_view text = name_table::text (id);
+   uint32_t index = static_cast<uint32_t> (names.size());
+   names.push_back ({static_cast<uint32_t> (name_text.size()),
+                     static_cast<uint32_t> (text.size())});
+   name_text.append (text);
+   name_index.emplace (id, index);
+   return index;
+}
+
+snapshot_record image::record_for (const inode* node) {
+   dirent_key key = node->key();
+   snapshot_record record {};
+   record.key = add_name (key.id()) << 1 | (key.is_dir() ? 1 : 0);
+   record.inode_nr = node->get_inode_nr();
+   if (not key.is_dir()) {
+      string_view data = node->read();
+      if (data.size() > numeric_limits<uint32_t>::max()) {
+         throw file_error ("file too large for a snapshot");
+      }
+      record.first = contents_size;
+      record.count = static_cast<uint32_t> (data.size());
+      contents_size += data.size();
+      contents.push_back (data);
+   }
+   return record;
+}
+
+// image ctor -
+//    Breadth first, so each directory's children are appended as
+//    one run while the directory's own record is being filled in.
+
+image::image (const inode_ptr& root) {
+   vector<const inode*> nodes {root.get()};
+   records.push_back (record_for (root.get()));
+   for (size_t index = 0; index < nodes.size(); ++index) {
+      if (not records[index].is_dir()) continue;
+      const dirent_map& lower = nodes[index]->get_lower();
+      records[index].first = records.size();
+      records[index].count = static_cast<uint32_t> (lower.size());
+      for (const auto& entry: lower) {
+         nodes.push_back (entry.second.get());
+         records.push_back (record_for (entry.second.get()));
+      }
+   }
+}
+
+}
+
+// write_file -
+//    Writes a file by calling write on a stream over a temporary
+//    file beside it, which is made durable and renamed over it, so
+//    an existing file is never left half written.
+
+template <typename writer_t>
+void write_file (const string& filename, writer_t write) {
+   string temp = filename + ".tmp";
+   int fd = open (temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (fd < 0) throw snapshot_error (temp, strerror (errno));
+   bool good;
+   {
+      output_sink sink (fd, output_sink::mode::BATCH);
+      ostream out (&sink);
+      write (out);
+      out.flush();
+      good = out.good() and fdatasync (fd) == 0;
+   }
+   int saved = errno;
+   if (close (fd) != 0 and good) {
+      good = false;
+      saved = errno;
+   }
+   if (good and rename (temp.c_str(), filename.c_str()) != 0) {
+      good = false;
+      saved = errno;
+   }
+   if (not good) {
+      unlink (temp.c_str());
+      throw snapshot_error (filename, strerror (saved));
+   }
+}
+
+void save_snapshot (const string& filename, const inode_ptr& root,
+                    uint64_t journal_seq) {
+   image tree (root);
+   snapshot_header header {};
+   memcpy (header.magic, snapshot_header::MAGIC, sizeof header.magic);
+   header.version = snapshot_header::VERSION;
+   header.order = snapshot_header::ORDER_MARK;
+   header.name_count = tree.names.size();
+   header.names_offset = align8 (sizeof header);
+   header.record_count = tree.records.size();
+   header.records_offset = align8 (header.names_offset
+         + tree.names.size() * sizeof (snapshot_name)
+         + tree.name_text.size());
+   header.contents_size = tree.contents_size;
+   header.contents_offset = header.records_offset
+         + tree.records.size() * sizeof (snapshot_record);
+   header.journal_seq = journal_seq;
+
+   write_file (filename, [&] (ostream& out) {
+      auto put = [&out] (const void* data, size_t size) {
+         out.write (static_cast<const char*> (data),
+                    static_cast<streamsize> (size));
+      };
+      auto pad = [&out] (size_t written) {
+         for (; written % 8 != 0; ++written) out.put ('\0');
+      };
+      put (&header, sizeof header);
+      pad (sizeof header);
+      put (tree.names.data(),
+           tree.names.size() * sizeof (snapshot_name));
+      put (tree.name_text.data(), tree.name_text.size());
+      pad (tree.name_text.size());
+      put (tree.records.data(),
+           tree.records.size() * sizeof (snapshot_record));
+      for (string_view data: tree.contents) {
+         put (data.data(), data.size());
+      }
+   });
+   DEBUGF ('p', filename << ": " << header.record_count << " inodes, "
+           << header.name_count << " names, " << header.contents_size
+           << " content bytes");
+}
+
+// snapshot_image ctor -
+//    Maps the file and checks everything a reader relies on without
+//    going through the names or the contents:  the header, that the
+//    sections fit, that every name lies inside the name text, and
+//    that the records form a tree.  The children of the directories
+//    must tile records 1 to count - 1 in order, so every record but
+//    the root has exactly one parent, which comes before it.  This
+//    is one sequential pass over the records and allocates nothing.
+
+snapshot_image::snapshot_image (const string& filename_):
+                filename (filename_) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) throw bad (strerror (errno));
+   struct stat info;
+   if (fstat (fd, &info) == 0 and S_ISREG (info.st_mode)
+       and info.st_size > 0) {
+      size_ = static_cast<size_t> (info.st_size);
+      addr = mmap (nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+   }
+   int saved = errno;
+   close (fd);
+   if (addr == MAP_FAILED) {
+      throw bad (size_ == 0 ? "not a snapshot" : strerror (saved));
+   }
+   try {
+      check();
+   }catch (...) {
+      munmap (addr, size_);
+      throw;
+   }
+   ids.assign (header.name_count, NOT_INTERNED);
+}
+
+snapshot_image::~snapshot_image() {
+   for (name_id id: ids) {
+      if (id != NOT_INTERNED) name_table::drop (id);
+   }
+   munmap (addr, size_);
+}
+
+// snapshot_image::save_copy -
+//    The header goes out with the new journal_seq; everything after
+//    it is the mapping as it stands.
+
+void snapshot_image::save_copy (const string& to,
+                                uint64_t journal_seq) const {
+   snapshot_header copy = header;
+   copy.journal_seq = journal_seq;
+   write_file (to, [&] (ostream& out) {
+      out.write (reinterpret_cast<const char*> (&copy), sizeof copy);
+      out.write (static_cast<const char*> (addr) + sizeof copy,
+                 static_cast<streamsize> (size_ - sizeof copy));
+   });
+   DEBUGF ('p', to << ": copied " << size_ << " bytes of "
+           << filename);
+}
+
+file_error snapshot_image::bad (const string& why) const {
+   return snapshot_error (filename, why);
+}
+
+// section_fits -
+//    Whether count entries of the given size starting at offset lie
+//    inside the file, without overflow.
+
+bool snapshot_image::section_fits (uint64_t offset, uint64_t count,
+                                   size_t entry_size) const {
+   if (offset > size_ or offset % 8 != 0) return false;
+   return count <= (size_ - offset) / entry_size;
+}
+
+void snapshot_image::check() {
+   const char* base = static_cast<const char*> (addr);
+   if (size_ < sizeof header) throw bad ("not a snapshot");
+   memcpy (&header, base, sizeof header);
+   if (memcmp (header.magic, snapshot_header::MAGIC,
+               sizeof header.magic) != 0) {
+      throw bad ("not a snapshot");
+   }
+   if (header.version != snapshot_header::VERSION
+       or header.order != snapshot_header::ORDER_MARK) {
+      throw bad ("unsupported snapshot version");
+   }
+   if (not section_fits (header.names_offset, header.name_count,
+                         sizeof (snapshot_name))
+       or not section_fits (header.records_offset, header.record_count,
+                            sizeof (snapshot_record))
+       or not section_fits (header.contents_offset,
+                            header.contents_size, 1)
+       or header.record_count == 0
+       or header.name_count > numeric_limits<uint32_t>::max() >> 1) {
+      throw bad ("corrupt snapshot header");
+   }
+   spans = reinterpret_cast<const snapshot_name*>
+           (base + header.names_offset);
+   size_t text_offset = header.names_offset
+                      + header.name_count * sizeof (snapshot_name);
+   if (text_offset > header.records_offset) {
+      throw bad ("corrupt snapshot header");
+   }
+   text = string_view (base + text_offset,
+                       header.records_offset - text_offset);
+   records = reinterpret_cast<const snapshot_record*>
+             (base + header.records_offset);
+   contents_ = base + header.contents_offset;
+
+   for (size_t index = 0; index < header.name_count; ++index) {
+      const snapshot_name& span = spans[index];
+      if (span.offset > text.size()
+          or span.length > text.size() - span.offset
+          or text.substr (span.offset, span.length).find ('/')
+             != string_view::npos) {
+         throw bad ("corrupt name table");
+      }
+   }
+   size_t count = header.record_count;
+   if (not records[0].is_dir()) throw bad ("root is not a directory");
+   size_t claimed = 1;
+   for (size_t index = 0; index < count; ++index) {
+      const snapshot_record& entry = records[index];
+      if (index > 0 and index >= claimed) throw bad ("orphan inode");
+      if (entry.name() >= header.name_count
+          or (index > 0 and spans[entry.name()].length == 0)) {
+         throw bad ("bad name index");
+      }
+      if (not entry.is_dir()) {
+         if (entry.first > header.contents_size
+             or entry.count > header.contents_size - entry.first) {
+            throw bad ("file contents out of range");
+         }
+         continue;
+      }
+      if (entry.first != claimed or entry.count > count - claimed) {
+         throw bad ("corrupt directory");
+      }
+      claimed += entry.count;
+   }
+   if (claimed != count) throw bad ("orphan inode");
+}
+
+name_id snapshot_image::name (uint32_t index) {
+   if (ids[index] == NOT_INTERNED) {
+      const snapshot_name& span = spans[index];
+      ids[index] = name_table::intern (text.substr (span.offset,
+                                                    span.length));
+      name_table::hold (ids[index]);
+   }
+   return ids[index];
+}
+
+string_view snapshot_image::contents (const snapshot_record& file)
+            const {
+   return string_view (contents_ + file.first, file.count);
+}
+
+// snapshot_image::check_order -
+//    The image is a tree; for dirents it must also be sorted with
+//    no duplicate in any directory.
+
+void snapshot_image::check_order (size_t index) {
+   const snapshot_record& entry = records[index];
+   for (size_t child = entry.first + 1;
+        child < entry.first + entry.count; ++child) {
+      const snapshot_record& left = records[child - 1];
+      const snapshot_record& right = records[child];
+      if (compare (dirent_key (name (left.name()), left.is_dir()),
+                   dirent_key (name (right.name()), right.is_dir()))
+          >= 0) {
+         throw bad ("corrupt directory");
+      }
+   }
+}
+
+inode_ptr snapshot_image::make_node (size_t index,
+                                     base_file_ptr data) {
+   const snapshot_record& entry = records[index];
+   inode_ptr node = inode::make (entry.is_dir()
+                                 ? file_type::DIRECTORY_TYPE
+                                 : file_type::PLAIN_TYPE,
+                                 entry.inode_nr, move (data));
+   node->set_name (name (entry.name()));
+   return node;
+}
+
+inode_ptr load_snapshot (const string& filename,
+                         uint64_t* journal_seq) {
+   snapshot_image image (filename);
+   if (journal_seq != nullptr) *journal_seq = image.journal_seq();
+   size_t count = image.size();
+
+   for (size_t index = 0; index < count; ++index) {
+      if (image.record (index).is_dir()) image.check_order (index);
+   }
+
+   // Build the tree.  Each node is owned by its directory as soon as
+   // it is made, so plain pointers are enough to find the parents.
+   wordvec data (1);
+   vector<inode*> nodes (count);
+   inode_ptr root = image.make_node (0);
+   root->set_parent (root.get());
+   nodes[0] = root.get();
+   for (size_t index = 0; index < count; ++index) {
+      const snapshot_record& entry = image.record (index);
+      if (not entry.is_dir()) continue;
+      for (size_t child = entry.first;
+           child < entry.first + entry.count; ++child) {
+         inode_ptr node = image.make_node (child);
+         if (not node->key().is_dir()) {
+            data[0] = image.contents (image.record (child));
+            node->write ({data.cbegin(), data.cend()});
+         }
+         node->set_parent (nodes[index]);
+         nodes[index]->add_lower (node);
+         nodes[child] = node.get();
+      }
+   }
+   DEBUGF ('p', filename << ": loaded " << count << " inodes");
+   return root;
+}
+
+mounted_directory::mounted_directory (snapshot_image_ptr image_,
+                                      size_t record_):
+                   image (move (image_)), record (record_) {
+}
+
+// mounted_directory::expand -
+//    Called from const lookups, so it casts away const to fill in
+//    the dirents; to callers the directory has been full all along.
+//    The record is checked as load checks it before anything is
+//    added, so a corrupt directory throws on every lookup.  The
+//    directory counts as expanded only once every child is in; if
+//    making one throws, those already added are dropped, so the
+//    next lookup tries again rather than seeing part of it.
+
+void mounted_directory::expand() const {
+   if (expanded) return;
+   auto self = const_cast<mounted_directory*> (this);
+   image->check_order (record);
+   const snapshot_record& entry = image->record (record);
+   try {
+      for (size_t child = entry.first;
+           child < entry.first + entry.count; ++child) {
+         const snapshot_record& lower = image->record (child);
+         inode_ptr node;
+         if (lower.is_dir()) {
+            auto dir = make_pooled<mounted_directory> (image, child);
+            node = image->make_node (child, dir);
+            dir->set_owner (node.get());
+         }else {
+            node = image->make_node (child, make_pooled<mounted_file>
+                                     (image, image->contents (lower)));
+         }
+         node->set_parent (owner);
+         self->directory::add_child (node);
+      }
+   }catch (...) {
+      vector<inode_ptr> added;
+      self->directory::detach_children (added);
+      throw;
+   }
+   self->expanded = true;
+   DEBUGF ('p', "expanded record " << record << ", "
+           << entry.count << " children");
+}
+
+// mounted_directory::size -
+//    From the record, whether or not the dirents are filled in, so
+//    an lsr worker can size a child while the walker expands it.
+
+size_t mounted_directory::size() const {
+   return image->record (record).count + 2;
+}
+
+size_t mounted_directory::footprint() const {
+   return sizeof (mounted_directory) - sizeof (directory)
+        + directory::footprint();
+}
+
+bool mounted_directory::save_image (const string& to,
+                                    uint64_t journal_seq) const {
+   if (record != 0) return false;
+   image->save_copy (to, journal_seq);
+   return true;
+}
+
+base_file_ptr mounted_directory::clone() const {
+   throw file_error ("is a " + error_file_type());
+}
+
+inode_ptr mounted_directory::mkdir (string_view) {
+   throw file_error ("is a " + error_file_type());
+}
+
+inode_ptr mounted_directory::mkfile (string_view) {
+   throw file_error ("is a " + error_file_type());
+}
+
+const dirent_map& mounted_directory::get_children() const {
+   expand();
+   return directory::get_children();
+}
+
+inode_ptr mounted_directory::find_child (string_view name) const {
+   expand();
+   return directory::find_child (name);
+}
+
+inode_ptr mounted_directory::find_subdir (string_view name) const {
+   expand();
+   return directory::find_subdir (name);
+}
+
+void mounted_directory::add_child (const inode_ptr&) {
+   throw file_error ("is a " + error_file_type());
+}
+
+bool mounted_directory::erase_child (string_view, bool) {
+   throw file_error ("is a " + error_file_type());
+}
+
+mounted_file::mounted_file (snapshot_image_ptr image_,
+                            string_view data_):
+              image (move (image_)), data (data_) {
+}
+
+size_t mounted_file::footprint() const {
+   return sizeof (mounted_file);
+}
+
+inode_ptr mount_snapshot (const string& filename) {
+   auto image = make_shared<snapshot_image> (filename);
+   auto dir = make_pooled<mounted_directory> (image, 0);
+   inode_ptr root = image->make_node (0, dir);
+   dir->set_owner (root.get());
+   root->set_parent (root.get());
+   DEBUGF ('p', filename << ": mounted " << image->size()
+           << " inodes");
+   return root;
+}
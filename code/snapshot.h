@@ -0,0 +1,236 @@
+// $Id: snapshot.h,v 1.1 2026-10-17 12:00:00-07 - - $
+// Evan Clark, Brady Chan
+//
+// snapshot -
+//    Binary image of a whole tree, for save, load and yshell -l.
+//    The file is four sections, each starting on an 8-byte
+//    boundary, in host byte order:
+//       header   - snapshot_header, with the section offsets
+//       names    - one snapshot_name span per distinct name, then
+//                  the text of all of them, unterminated
+//       records  - one snapshot_record per inode, breadth first,
+//                  so the root is record 0 and the children of each
+//                  directory are a run of consecutive records in
+//                  dirent order
+//       contents - the bytes of every plain file, back to back
+//    Everything is fixed width and addressed by offset, so a loader
+//    can work straight from a read-only mapping of the file, and a
+//    mount can build any one directory without reading the others.
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+
+// snapshot_header -
+//    magic and version identify the format; order is ORDER_MARK as
+//    written, so a file from a machine of the other byte order is
+//    rejected rather than misread.  Sizes are counts of entries,
+//    offsets are from the start of the file.  journal_seq is the
+//    last journal record the tree includes, for a checkpoint, and
+//    zero otherwise.
+
+struct snapshot_header {
+   static constexpr char MAGIC[8] {'Y','S','H','S','N','A','P','\0'};
+   static constexpr uint32_t VERSION {2};
+   static constexpr uint32_t ORDER_MARK {0x01020304};
+   char magic[8];
+   uint32_t version;
+   uint32_t order;
+   uint64_t name_count;
+   uint64_t names_offset;
+   uint64_t record_count;
+   uint64_t records_offset;
+   uint64_t contents_size;
+   uint64_t contents_offset;
+   uint64_t journal_seq;
+};
+
+// snapshot_name -
+//    Where a name's text lies, relative to the end of the spans.
+
+struct snapshot_name {
+   uint32_t offset;
+   uint32_t length;
+};
+
+// snapshot_record -
+//    One inode.  key is the name's index in the name section,
+//    shifted left one, with the low bit set for a directory, as in
+//    dirent_key.  For a directory, first is the record index of its
+//    first child and count the number of children.  For a plain
+//    file, first is the offset of its bytes in the contents section
+//    and count their length.  inode_nr is kept so ls shows the same
+//    numbers after a load.
+
+struct snapshot_record {
+   uint32_t key;
+   uint32_t count;
+   uint64_t first;
+   uint64_t inode_nr;
+   bool is_dir() const { return key & 1; }
+   uint32_t name() const { return key >> 1; }
+};
+
+// snapshot_image -
+//    A snapshot file mapped read-only, for as long as the object
+//    lives.  The constructor checks that the file is a snapshot of
+//    this version and that its records form a tree, and throws
+//    file_error if not.  It builds nothing.
+// record, size -
+//    Record index of the image, and the number of records.
+// journal_seq -
+//    As in the header.
+// name -
+//    The interned handle of a name in the name section.  Names are
+//    interned the first time they are asked for and held until the
+//    image goes.  Shell thread only.
+// check_order -
+//    Throws file_error unless the children of a directory record
+//    are sorted as dirents, with no duplicate.
+// contents -
+//    The bytes of a plain file, straight from the mapping.
+// make_node -
+//    A new inode for a record, with its number and name, holding
+//    the given contents or, if none, empty ones of its type.
+// save_copy -
+//    Writes the image to another snapshot file, as save_snapshot
+//    would, but with a new journal_seq.
+// bad -
+//    A file_error naming the file.
+
+class snapshot_image {
+   private:
+      static constexpr name_id NOT_INTERNED {~name_id (0)};
+      string filename;
+      void* addr {MAP_FAILED};
+      size_t size_ {0};
+      snapshot_header header {};
+      const snapshot_name* spans {nullptr};
+      string_view text;
+      const snapshot_record* records {nullptr};
+      const char* contents_ {nullptr};
+      vector<name_id> ids;
+      bool section_fits (uint64_t offset, uint64_t count,
+                         size_t entry_size) const;
+      void check();
+   public:
+      explicit snapshot_image (const string& filename);
+      ~snapshot_image();
+      snapshot_image (const snapshot_image&) = delete;
+      snapshot_image& operator= (const snapshot_image&) = delete;
+      const snapshot_record& record (size_t index) const {
+         return records[index];
+      }
+      size_t size() const { return header.record_count; }
+      uint64_t journal_seq() const { return header.journal_seq; }
+      name_id name (uint32_t index);
+      void check_order (size_t index);
+      string_view contents (const snapshot_record& file) const;
+      inode_ptr make_node (size_t index, base_file_ptr data = nullptr);
+      void save_copy (const string& to, uint64_t journal_seq) const;
+      file_error bad (const string& why) const;
+};
+using snapshot_image_ptr = shared_ptr<snapshot_image>;
+
+// class mounted_directory -
+// A directory of a mounted snapshot.  It starts out empty and is
+// filled in from its run of records the first time anything looks
+// at its children, so a session only builds the directories it
+// visits.  Its children are in turn mounted directories and mounted
+// files.  size and footprint don't fill it in, so listing the parent
+// costs nothing below it, and neither does freeing it.  The tree is
+// read-only:  clone, mkdir, mkfile, add_child and erase_child throw
+// file_error.
+// expand -
+//    Fills in the dirents if they are not there yet.  This is not
+//    thread safe, so a parallel lsr expands each directory on the
+//    writer's thread before a worker can see it.
+// set_owner -
+//    The inode holding this directory, the dotdot of its children.
+// save_image -
+//    If this is the root of its image, saves the image to a file as
+//    by save_copy and returns true.  The tree cannot change, so the
+//    image is a snapshot of it, written without expanding anything.
+
+class mounted_directory: public directory {
+   private:
+      snapshot_image_ptr image;
+      size_t record;
+      inode* owner {nullptr};
+      bool expanded {false};
+      virtual const string& error_file_type() const override {
+         static const string result = "read-only directory";
+         return result;
+      }
+   public:
+      mounted_directory (snapshot_image_ptr image_, size_t record_);
+      void expand() const;
+      void set_owner (inode* owner_) { owner = owner_; }
+      bool save_image (const string& to, uint64_t journal_seq) const;
+      virtual size_t size() const override;
+      virtual size_t footprint() const override;
+      virtual base_file_ptr clone() const override;
+      virtual inode_ptr mkdir (string_view dirname) override;
+      virtual inode_ptr mkfile (string_view filename) override;
+      virtual const dirent_map& get_children() const override;
+      virtual inode_ptr find_child (string_view name)
+      const override;
+      virtual inode_ptr find_subdir (string_view name)
+      const override;
+      virtual void add_child (const inode_ptr& child) override;
+      virtual bool erase_child (string_view name, bool is_dir)
+      override;
+};
+
+// class mounted_file -
+// A plain file of a mounted snapshot.  readfile is a view of the
+// mapping, which the file keeps alive; nothing is copied.  Writing
+// it throws file_error.
+
+class mounted_file: public base_file {
+   private:
+      snapshot_image_ptr image;
+      string_view data;
+      virtual const string& error_file_type() const override {
+         static const string result = "read-only file";
+         return result;
+      }
+   public:
+      mounted_file (snapshot_image_ptr image_, string_view data_);
+      virtual size_t size() const override { return data.size(); }
+      virtual size_t footprint() const override;
+      virtual string_view readfile() const override { return data; }
+      virtual string get_type() override { return "p"; }
+};
+
+// save_snapshot -
+//    Writes the tree under root to filename.  The image is written
+//    to a temporary file beside it, made durable, and renamed over
+//    it, so an existing snapshot is never left half written.
+//    Throws file_error if the file cannot be written.
+// load_snapshot -
+//    Reads a snapshot in one pass and returns the root of a new
+//    tree built from it, and its journal_seq if asked.  Throws
+//    file_error, and builds nothing, if the file is unreadable, of
+//    another version, or inconsistent.
+// mount_snapshot -
+//    Maps a snapshot and returns the root of a read-only tree of
+//    mounted directories and files over it.  Only the root is built
+//    here.  Throws file_error as load_snapshot does.
+
+void save_snapshot (const string& filename, const inode_ptr& root,
+                    uint64_t journal_seq = 0);
+inode_ptr load_snapshot (const string& filename,
+                         uint64_t* journal_seq = nullptr);
+inode_ptr mount_snapshot (const string& filename);
+
+#endif
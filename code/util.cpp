@@ -38,7 +38,7 @@ void exec::status (int status) {
 }
 
 
-wordvec split (const string& line, const string& delimiters) {
+wordvec split (string_view line, string_view delimiters) {
    wordvec words;
    size_t end = 0;
 
@@ -46,7 +46,7 @@ wordvec split (const string& line, const string& delimiters) {
    // thus found, append it to the output wordvec.
    for (;;) {
       size_t start = line.find_first_not_of (delimiters, end);
-      if (start == string::npos) break;
+      if (start == string_view::npos) break;
       end = line.find_first_of (delimiters, start);
       words.push_back (line.substr (start, end - start));
    }
@@ -11,15 +11,18 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
 
 // Convenient type using to allow brevity of code elsewhere.
+// The words of a command are views into the line or script they
+// came from, which must outlive them.
 
 template <typename iterator>
 using range_type = pair<iterator,iterator>;
 
-using wordvec = vector<string>;
+using wordvec = vector<string_view>;
 using word_range = range_type<decltype(declval<wordvec>().cbegin())>;
 
 // want_echo -
@@ -54,8 +57,9 @@ class exec {
 //    Split a string into a wordvec (as defined above).  Any sequence
 //    of chars in the delimiter string is used as a separator.  To
 //    Split a pathname, use "/".  To split a shell command, use " ".
+//    The words point into line; nothing is copied.
 
-wordvec split (const string& line, const string& delimiter);
+wordvec split (string_view line, string_view delimiter);
 
 // complain -
 //    Used for starting error messages.  Sets the exit status to